@@ -0,0 +1,518 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "boost.h"
+#include "presort.h"
+#include "thread_pool.h"
+#include "input.h"
+
+#define PARALLEL_WORK 65536 // Least rows times features a histogram needs before it's built on several threads
+#define PREDICT_BLOCK 256   // Rows that go through every tree together while predicting
+#define MIN_HESSIAN 1e-16   // Floor of a row's hessian, so leaves of confident rows stay finite
+
+// Options
+
+// Sets the options to 100 rounds of depth 6 trees over 256 bins per feature
+void defaultBoostOptions(BoostOptions* options) {
+  options->numRounds = 100;
+  options->maxDepth = 6;
+  options->maxBins = MAX_BINS;
+  options->learningRate = 0.1;
+  options->lambda = 1.0;
+  options->minChildWeight = 1.0;
+  options->numThreads = 0;
+}
+
+
+
+// Binned Features
+
+// Bins every feature by walking its sort order: each distinct value gets its own bin if there are
+// few enough, otherwise bins hold about the same weight of instances and never split equal values.
+// A split after bin b sends the same instances left as the split "<= upper[f][b]" on the raw values.
+BinnedFeatures* binFeatures(SortedFeatures* sorted, int maxBins) {
+  assert(sorted != NULL);
+  assert(maxBins >= 2 && maxBins <= MAX_BINS);
+  int numFeatures = sorted->numFeatures;
+  int numInstances = sorted->numInstances;
+
+  BinnedFeatures* binned = (BinnedFeatures*)malloc(sizeof(BinnedFeatures));
+  binned->numFeatures = numFeatures;
+  binned->numInstances = numInstances;
+  binned->numBins = (int*)malloc(sizeof(int) * numFeatures);
+  binned->binStart = (int*)malloc(sizeof(int) * (numFeatures + 1));
+  binned->upper = (double**)malloc(sizeof(double*) * numFeatures);
+  binned->bins = (unsigned char**)malloc(sizeof(unsigned char*) * numFeatures);
+
+  long totalWeight = 0;
+  for (int i = 0; i < numInstances; i++)
+    totalWeight += sorted->weights[i];
+
+  binned->binStart[0] = 0;
+  for (int f = 0; f < numFeatures; f++) {
+    int* order = sorted->order[f];
+    double* column = sorted->columns[f];
+    binned->upper[f] = (double*)malloc(sizeof(double) * maxBins);
+    binned->bins[f] = (unsigned char*)malloc(numInstances > 0 ? numInstances : 1);
+
+    int numDistinct = 0;
+    for (int j = 0; j < numInstances; j++)
+      if (j == 0 || column[order[j]] != column[order[j - 1]])
+	numDistinct++;
+
+    // close a bin where the value changes, once it holds its share of the weight
+    int numBins = 0;
+    long weight = 0;
+    for (int j = 0; j < numInstances; j++) {
+      int i = order[j];
+      binned->bins[f][i] = (unsigned char) numBins;
+      binned->upper[f][numBins] = column[i];
+      weight += sorted->weights[i];
+
+      _Bool lastOfValue = j == numInstances - 1 || column[order[j + 1]] != column[i];
+      if (lastOfValue && j < numInstances - 1 && numBins < maxBins - 1
+	  && (numDistinct <= maxBins || (double) weight * maxBins >= (double) totalWeight * (numBins + 1)))
+	numBins++;
+    }
+    if (numInstances > 0)
+      numBins++;
+
+    binned->numBins[f] = numBins;
+    binned->binStart[f + 1] = binned->binStart[f] + numBins;
+  }
+
+  return binned;
+}
+
+// Frees the bins and the structure itself
+void freeBinnedFeatures(BinnedFeatures* binned) {
+  for (int f = 0; f < binned->numFeatures; f++) {
+    free(binned->upper[f]);
+    free(binned->bins[f]);
+  }
+  free(binned->upper);
+  free(binned->bins);
+  free(binned->numBins);
+  free(binned->binStart);
+  free(binned);
+}
+
+
+
+// Training
+
+// Sums of the gradients and hessians of the instances in one bin
+typedef struct GradientSum {
+  double gradient;
+  double hessian;
+} GradientSum;
+
+// State of one makeEnsemble call; every buffer is allocated once and reused by every round
+typedef struct Booster {
+  SortedFeatures* sorted;
+  BinnedFeatures* binned;
+  BoostOptions* options;
+  Ensemble* ensemble;
+  int numClasses;
+  int numInstances;
+
+  double* scores;    // scores[i * numClasses + c] is the current score of instance i for class c
+  double* gradients; // gradients[c * numInstances + i] is the gradient of the loss for instance i and class c
+  double* hessians;  // Same layout as gradients
+  int* rows;         // Instances of the tree being grown; each node's rows are contiguous
+
+  // histograms[s * numEntries + binStart[f] + b] sums bin b of feature f; slot s holds a node at depth s
+  // until its children are split, then its right child, and slot s+1 its left child
+  GradientSum* histograms;
+  int numEntries;
+
+  ThreadPool* pool; // Started once per ensemble; builds the histograms of large nodes
+
+  // the histogram being built by the tasks
+  int class;
+  GradientSum* histogram;
+  int lo;
+  int hi;
+} Booster;
+
+// Task: sums the gradients of rows [lo, hi) into the histogram of one feature
+static void histogramTask(void* context, int f) {
+  Booster* b = (Booster*) context;
+  GradientSum* histogram = b->histogram + b->binned->binStart[f];
+  unsigned char* bins = b->binned->bins[f];
+  double* gradients = b->gradients + (long) b->class * b->numInstances;
+  double* hessians = b->hessians + (long) b->class * b->numInstances;
+
+  memset(histogram, 0, sizeof(GradientSum) * b->binned->numBins[f]);
+  for (int j = b->lo; j < b->hi; j++) {
+    int i = b->rows[j];
+    histogram[bins[i]].gradient += gradients[i];
+    histogram[bins[i]].hessian += hessians[i];
+  }
+}
+
+// Builds the histogram of every feature for rows [lo, hi) into the slot, one task per feature
+static void buildHistogram(Booster* b, int slot, int lo, int hi) {
+  b->histogram = b->histograms + (long) slot * b->numEntries;
+  b->lo = lo;
+  b->hi = hi;
+  int numFeatures = b->binned->numFeatures;
+  if ((long) (hi - lo) * numFeatures >= PARALLEL_WORK)
+    poolRun(b->pool, histogramTask, b, numFeatures);
+  else
+    for (int f = 0; f < numFeatures; f++)
+      histogramTask(b, f);
+}
+
+// Returns the part of the loss a leaf with these sums removes (the larger, the better)
+static inline double leafGain(Booster* b, double gradient, double hessian) {
+  return gradient * gradient / (hessian + b->options->lambda);
+}
+
+// Finds the split with the largest gain in the slot's histogram, whose sums are gradient and hessian
+// Returns 0 if no split gains anything or keeps enough hessian on both sides. Ties go to the lowest
+// feature, then the lowest bin.
+static _Bool findSplit(Booster* b, int slot, double gradient, double hessian, int* featureOut, int* binOut) {
+  GradientSum* histogram = b->histograms + (long) slot * b->numEntries;
+  double minChildWeight = b->options->minChildWeight;
+  double parentGain = leafGain(b, gradient, hessian);
+  double bestGain = 0;
+  _Bool found = 0;
+
+  for (int f = 0; f < b->binned->numFeatures; f++) {
+    GradientSum* sums = histogram + b->binned->binStart[f];
+    double leftGradient = 0;
+    double leftHessian = 0;
+    for (int bin = 0; bin < b->binned->numBins[f] - 1; bin++) {
+      leftGradient += sums[bin].gradient;
+      leftHessian += sums[bin].hessian;
+      double rightHessian = hessian - leftHessian;
+      if (leftHessian < minChildWeight || rightHessian < minChildWeight)
+	continue;
+
+      double gain = leafGain(b, leftGradient, leftHessian) + leafGain(b, gradient - leftGradient, rightHessian) - parentGain;
+      if (gain > bestGain) {
+	bestGain = gain;
+	*featureOut = f;
+	*binOut = bin;
+	found = 1;
+      }
+    }
+  }
+
+  return found;
+}
+
+// Appends a node to the ensemble and returns its index
+static int appendBoostNode(Ensemble* ensemble, int feature, double value) {
+  if (ensemble->numNodes == ensemble->capacity) {
+    ensemble->capacity *= 2;
+    ensemble->nodes = (BoostNode*)realloc(ensemble->nodes, sizeof(BoostNode) * ensemble->capacity);
+  }
+  int index = ensemble->numNodes;
+  ensemble->numNodes++;
+  ensemble->nodes[index].feature = feature;
+  ensemble->nodes[index].right = -1;
+  ensemble->nodes[index].value = value;
+  return index;
+}
+
+// Grows the subtree of rows [lo, hi), whose histogram is in the slot and sums to gradient and hessian,
+// and adds its leaf values to the rows' scores
+static void growNode(Booster* b, int lo, int hi, int depth, int slot, double gradient, double hessian) {
+  int feature, bin;
+  if (depth >= b->options->maxDepth || hi - lo < 2 || !findSplit(b, slot, gradient, hessian, &feature, &bin)) {
+    double value = -b->options->learningRate * gradient / (hessian + b->options->lambda);
+    appendBoostNode(b->ensemble, -1, value);
+    for (int j = lo; j < hi; j++)
+      b->scores[(long) b->rows[j] * b->numClasses + b->class] += value;
+    return;
+  }
+
+  // partition the rows in place
+  unsigned char* bins = b->binned->bins[feature];
+  int mid = lo;
+  for (int j = lo; j < hi; j++)
+    if (bins[b->rows[j]] <= bin) {
+      int row = b->rows[j];
+      b->rows[j] = b->rows[mid];
+      b->rows[mid] = row;
+      mid++;
+    }
+
+  // build the smaller child's histogram, take the larger one's as the difference from the parent,
+  // then leave the left one in the next slot and the right one in this slot
+  GradientSum* parent = b->histograms + (long) slot * b->numEntries;
+  GradientSum* child = parent + b->numEntries;
+  _Bool leftSmaller = mid - lo <= hi - mid;
+  if (leftSmaller)
+    buildHistogram(b, slot + 1, lo, mid);
+  else
+    buildHistogram(b, slot + 1, mid, hi);
+
+  double leftGradient = 0;
+  double leftHessian = 0;
+  for (int e = 0; e < b->numEntries; e++) {
+    GradientSum small = child[e];
+    GradientSum large = { parent[e].gradient - small.gradient, parent[e].hessian - small.hessian };
+    child[e] = leftSmaller ? small : large;
+    parent[e] = leftSmaller ? large : small;
+  }
+  for (int e = b->binned->binStart[0]; e < b->binned->binStart[1]; e++) {
+    leftGradient += child[e].gradient;
+    leftHessian += child[e].hessian;
+  }
+
+  int index = appendBoostNode(b->ensemble, feature, b->binned->upper[feature][bin]);
+  growNode(b, lo, mid, depth + 1, slot + 1, leftGradient, leftHessian);
+  b->ensemble->nodes[index].right = b->ensemble->numNodes;
+  growNode(b, mid, hi, depth + 1, slot, gradient - leftGradient, hessian - leftHessian);
+}
+
+// Returns the weight of instance i with class c
+static inline double classWeightOf(SortedFeatures* sorted, int i, int c) {
+  if (sorted->classWeights)
+    return sorted->classWeights[(long) i * sorted->numClasses + c];
+  return sorted->classes[i] == c ? sorted->weights[i] : 0;
+}
+
+// Sets the gradients and hessians of the softmax loss at the current scores
+// A weighted instance counts as weights[i] instances, classWeights of them per class.
+static void computeGradients(Booster* b) {
+  int numClasses = b->numClasses;
+  double probabilities[numClasses];
+
+  for (int i = 0; i < b->numInstances; i++) {
+    double* scores = b->scores + (long) i * numClasses;
+    double maxScore = scores[0];
+    for (int c = 1; c < numClasses; c++)
+      if (scores[c] > maxScore)
+	maxScore = scores[c];
+    double total = 0;
+    for (int c = 0; c < numClasses; c++) {
+      probabilities[c] = exp(scores[c] - maxScore);
+      total += probabilities[c];
+    }
+
+    double weight = b->sorted->weights[i];
+    for (int c = 0; c < numClasses; c++) {
+      double p = probabilities[c] / total;
+      double hessian = weight * p * (1 - p);
+      b->gradients[(long) c * b->numInstances + i] = weight * p - classWeightOf(b->sorted, i, c);
+      b->hessians[(long) c * b->numInstances + i] = hessian > MIN_HESSIAN ? hessian : MIN_HESSIAN;
+    }
+  }
+}
+
+// Boosts regression trees on the softmax loss of the sorted instances, whose features are binned
+// Every round fits one tree per class to the gradients of that class's score. The histograms of a
+// node come from one pass over its rows per feature (spread over the threads of a pool that is started
+// once, for large nodes), and the larger child's histogram is the parent's minus the smaller child's.
+// The bins, scores, gradients and histograms are allocated once for all rounds.
+Ensemble* makeEnsemble(SortedFeatures* sorted, BinnedFeatures* binned, BoostOptions* options) {
+  assert(sorted != NULL);
+  assert(binned != NULL);
+  assert(options != NULL);
+  assert(options->maxDepth >= 1);
+  assert(options->numRounds >= 0);
+  assert(sorted->numInstances > 0);
+  int numClasses = sorted->numClasses;
+  int numInstances = sorted->numInstances;
+
+  Ensemble* ensemble = (Ensemble*)malloc(sizeof(Ensemble));
+  ensemble->numClasses = numClasses;
+  ensemble->numFeatures = sorted->numFeatures;
+  ensemble->numTrees = 0;
+  ensemble->base = (double*)malloc(sizeof(double) * numClasses);
+  ensemble->roots = (int*)malloc(sizeof(int) * (options->numRounds * numClasses + 1));
+  ensemble->capacity = 1024;
+  ensemble->nodes = (BoostNode*)malloc(sizeof(BoostNode) * ensemble->capacity);
+  ensemble->numNodes = 0;
+
+  Booster b;
+  b.sorted = sorted;
+  b.binned = binned;
+  b.options = options;
+  b.ensemble = ensemble;
+  b.numClasses = numClasses;
+  b.numInstances = numInstances;
+  b.numEntries = binned->binStart[binned->numFeatures];
+  b.scores = (double*)malloc(sizeof(double) * numInstances * numClasses);
+  b.gradients = (double*)malloc(sizeof(double) * numInstances * numClasses);
+  b.hessians = (double*)malloc(sizeof(double) * numInstances * numClasses);
+  b.rows = (int*)malloc(sizeof(int) * numInstances);
+  b.histograms = (GradientSum*)malloc(sizeof(GradientSum) * (options->maxDepth + 1) * (b.numEntries > 0 ? b.numEntries : 1));
+  b.pool = makeThreadPool(options->numThreads);
+
+  // start from the log of each class's (smoothed) share of the weight
+  double totalWeight = 0;
+  for (int i = 0; i < numInstances; i++)
+    totalWeight += sorted->weights[i];
+  for (int c = 0; c < numClasses; c++) {
+    double classWeight = 0;
+    for (int i = 0; i < numInstances; i++)
+      classWeight += classWeightOf(sorted, i, c);
+    ensemble->base[c] = log((classWeight + 1) / (totalWeight + numClasses));
+  }
+  for (int i = 0; i < numInstances; i++)
+    memcpy(b.scores + (long) i * numClasses, ensemble->base, sizeof(double) * numClasses);
+
+  for (int round = 0; round < options->numRounds; round++) {
+    computeGradients(&b);
+
+    for (int c = 0; c < numClasses; c++) {
+      b.class = c;
+      for (int i = 0; i < numInstances; i++)
+	b.rows[i] = i;
+
+      double gradient = 0;
+      double hessian = 0;
+      for (int i = 0; i < numInstances; i++) {
+	gradient += b.gradients[(long) c * numInstances + i];
+	hessian += b.hessians[(long) c * numInstances + i];
+      }
+
+      buildHistogram(&b, 0, 0, numInstances);
+      ensemble->roots[ensemble->numTrees] = ensemble->numNodes;
+      ensemble->numTrees++;
+      growNode(&b, 0, numInstances, 0, 0, gradient, hessian);
+    }
+  }
+
+  free(b.scores);
+  free(b.gradients);
+  free(b.hessians);
+  free(b.rows);
+  free(b.histograms);
+  freeThreadPool(b.pool);
+  return ensemble;
+}
+
+
+
+// Prediction
+
+// Adds up the scores of a block of rows: every tree is walked for all of the block's rows before
+// the next tree, so the tree stays in cache while the rows' scores are updated in place
+static void scoreBlock(Ensemble* ensemble, double* rows, int numRows, double* scores) {
+  int numClasses = ensemble->numClasses;
+  int numFeatures = ensemble->numFeatures;
+  BoostNode* nodes = ensemble->nodes;
+
+  for (int r = 0; r < numRows; r++)
+    memcpy(scores + (long) r * numClasses, ensemble->base, sizeof(double) * numClasses);
+
+  for (int t = 0; t < ensemble->numTrees; t++) {
+    int root = ensemble->roots[t];
+    int c = t % numClasses;
+    for (int r = 0; r < numRows; r++) {
+      double* row = rows + (long) r * numFeatures;
+      int index = root;
+      while (nodes[index].feature >= 0)
+	index = row[nodes[index].feature] <= nodes[index].value ? index + 1 : nodes[index].right;
+      scores[(long) r * numClasses + c] += nodes[index].value;
+    }
+  }
+}
+
+// Returns the class with the highest score (the lowest class on ties)
+static inline int bestClass(double* scores, int numClasses) {
+  int best = 0;
+  for (int c = 1; c < numClasses; c++)
+    if (scores[c] > scores[best])
+      best = c;
+  return best;
+}
+
+// A batch split into blocks of rows, one task per block
+typedef struct PredictBatch {
+  Ensemble* ensemble;
+  double* rows;
+  int numRows;
+  double* scores; // Receives the scores if not NULL
+  int* classes;   // Receives the classes if not NULL
+} PredictBatch;
+
+// Task: scores one block of rows and picks their classes
+static void predictTask(void* context, int block) {
+  PredictBatch* batch = (PredictBatch*) context;
+  Ensemble* ensemble = batch->ensemble;
+  int numClasses = ensemble->numClasses;
+  int first = block * PREDICT_BLOCK;
+  int numRows = batch->numRows - first < PREDICT_BLOCK ? batch->numRows - first : PREDICT_BLOCK;
+
+  double* scores = batch->scores ? batch->scores + (long) first * numClasses
+    : (double*)malloc(sizeof(double) * numRows * numClasses);
+  scoreBlock(ensemble, batch->rows + (long) first * ensemble->numFeatures, numRows, scores);
+  if (batch->classes)
+    for (int r = 0; r < numRows; r++)
+      batch->classes[first + r] = bestClass(scores + (long) r * numClasses, numClasses);
+  if (!batch->scores)
+    free(scores);
+}
+
+// Runs the rows through the ensemble in blocks spread over the threads
+static void predictBatch(Ensemble* ensemble, double* rows, int numRows, double* scores, int* classes, int numThreads) {
+  assert(ensemble != NULL);
+  assert(numRows == 0 || rows != NULL);
+  PredictBatch batch = { ensemble, rows, numRows, scores, classes };
+  int numBlocks = (numRows + PREDICT_BLOCK - 1) / PREDICT_BLOCK;
+  runTasks(predictTask, &batch, numBlocks, numBlocks > 1 ? numThreads : 1);
+}
+
+// Sets scores[r * numClasses + c] to the score of row r for class c
+// rows holds numRows rows of the ensemble's number of features (row-major)
+void ensembleScores(Ensemble* ensemble, double* rows, int numRows, double* scores, int numThreads) {
+  assert(scores != NULL);
+  predictBatch(ensemble, rows, numRows, scores, NULL, numThreads);
+}
+
+// Sets classes[r] to the class with the highest score for row r
+void classifyEnsembleBatch(Ensemble* ensemble, double* rows, int numRows, int* classes, int numThreads) {
+  assert(classes != NULL);
+  predictBatch(ensemble, rows, numRows, NULL, classes, numThreads);
+}
+
+// Returns the class with the highest score for one row of feature values
+int classifyEnsemble(Ensemble* ensemble, double* featureValues) {
+  assert(ensemble != NULL);
+  assert(featureValues != NULL);
+  double scores[ensemble->numClasses];
+  scoreBlock(ensemble, featureValues, 1, scores);
+  return bestClass(scores, ensemble->numClasses);
+}
+
+// Returns the fraction of the instances (counting weights) the ensemble classifies correctly
+double ensembleAccuracy(Ensemble* ensemble, Instance** instances, int numInstances, int numThreads) {
+  assert(ensemble != NULL);
+  assert(instances != NULL);
+  assert(numInstances > 0);
+  int numFeatures = ensemble->numFeatures;
+
+  double* rows = (double*)malloc(sizeof(double) * numInstances * numFeatures);
+  int* classes = (int*)malloc(sizeof(int) * numInstances);
+  for (int i = 0; i < numInstances; i++)
+    memcpy(rows + (long) i * numFeatures, instances[i]->featureValues, sizeof(double) * numFeatures);
+  classifyEnsembleBatch(ensemble, rows, numInstances, classes, numThreads);
+
+  long countCorrect = 0;
+  long total = 0;
+  for (int i = 0; i < numInstances; i++) {
+    countCorrect += classWeight(instances[i], classes[i]);
+    total += instances[i]->weight;
+  }
+
+  free(rows);
+  free(classes);
+  return (double) countCorrect / (double) total;
+}
+
+// Frees the trees and the structure itself
+void freeEnsemble(Ensemble* ensemble) {
+  free(ensemble->base);
+  free(ensemble->roots);
+  free(ensemble->nodes);
+  free(ensemble);
+}
@@ -0,0 +1,64 @@
+#ifndef BOOST_H_
+#define BOOST_H_
+
+#include "input.h"
+#include "presort.h"
+
+#define MAX_BINS 256 // Most bins a feature can have, so a bin number fits in an unsigned char
+
+// Options
+typedef struct BoostOptions {
+  int numRounds;         // Boosting rounds, each adding one regression tree per class
+  int maxDepth;          // Depth of every tree (the root is depth 0), at least 1
+  int maxBins;           // Bins per feature, 2 to MAX_BINS
+  double learningRate;   // Factor applied to every leaf value
+  double lambda;         // L2 penalty on the leaf values
+  double minChildWeight; // Least hessian sum each side of a split needs
+  int numThreads;        // Threads the histograms and predictions are spread over (0 for one per processor)
+} BoostOptions;
+
+void defaultBoostOptions(BoostOptions* options);
+
+
+
+// Binned Features
+typedef struct BinnedFeatures { // The instances with every feature value replaced by the number of its bin
+  int numFeatures;
+  int numInstances;
+  int* numBins;         // numBins[f] is the number of bins of feature f
+  int* binStart;        // binStart[f] is the first histogram entry of feature f (binStart[numFeatures] entries in all)
+  double** upper;       // upper[f][b] is the largest value of feature f in bin b
+  unsigned char** bins; // bins[f][i] is the bin of instance i for feature f
+} BinnedFeatures;
+
+BinnedFeatures* binFeatures(SortedFeatures* sorted, int maxBins);
+void freeBinnedFeatures(BinnedFeatures* binned);
+
+
+
+// Ensemble
+typedef struct BoostNode { // A node of a regression tree, in preorder with the left child right after its parent
+  int feature;  // The feature to split on, -1 for a leaf
+  int right;    // Index of the child for values > the split
+  double value; // Decision: the value to split at. Leaf: what it adds to its class's score
+} BoostNode;
+
+typedef struct Ensemble {
+  int numClasses;
+  int numFeatures;
+  int numTrees;     // Tree t adds to the score of class t % numClasses
+  double* base;     // base[c] is the score every row starts with for class c
+  int* roots;       // roots[t] is the index of the root of tree t in nodes
+  BoostNode* nodes; // The nodes of every tree in one array
+  int numNodes;
+  int capacity;
+} Ensemble;
+
+Ensemble* makeEnsemble(SortedFeatures* sorted, BinnedFeatures* binned, BoostOptions* options);
+void ensembleScores(Ensemble* ensemble, double* rows, int numRows, double* scores, int numThreads);
+void classifyEnsembleBatch(Ensemble* ensemble, double* rows, int numRows, int* classes, int numThreads);
+int classifyEnsemble(Ensemble* ensemble, double* featureValues);
+double ensembleAccuracy(Ensemble* ensemble, Instance** instances, int numInstances, int numThreads);
+void freeEnsemble(Ensemble* ensemble);
+
+#endif
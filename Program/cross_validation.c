@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <time.h>
+#include "cross_validation.h"
+#include "thread_pool.h"
+#include "presort.h"
+#include "decision_tree.h"
+#include "input.h"
+
+// A fold is a pair of row-index views into the shared instances
+typedef struct Fold {
+  int* trainRows; // Increasing instance indices to train on
+  int numTrain;
+  int* testRows;  // Increasing instance indices held out for testing
+  int numTest;
+} Fold;
+
+// Outcome of one (configuration, fold) task
+typedef struct FoldResult {
+  int numCorrect; // Weighted instances count as the instances they stand for
+  int numNodes;
+  double trainSeconds;
+  _Bool failed;   // The tree couldn't be built for lack of memory
+} FoldResult;
+
+// Everything the tasks share; only results is written, and each task writes its own slot
+typedef struct CrossValidation {
+  Names* names;
+  SortedFeatures* sorted;
+  TrainOptions* configs;
+  Fold* folds;
+  int numFolds;
+  FoldResult* results; // results[config * numFolds + fold]
+} CrossValidation;
+
+// Returns the current time of a monotonic clock in seconds
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Assigns every instance to one of numFolds folds (shuffled with the seed, sizes differ by at most one)
+// and builds the train/test index views of each fold
+static Fold* makeFolds(int numInstances, int numFolds, unsigned int seed) {
+  int* foldOf = (int*)malloc(sizeof(int) * numInstances);
+  for (int i = 0; i < numInstances; i++)
+    foldOf[i] = i % numFolds;
+
+  // Fisher-Yates shuffle driven by a small LCG, so results are the same on every platform
+  unsigned long state = seed;
+  for (int i = numInstances - 1; i > 0; i--) {
+    state = state * 6364136223846793005UL + 1442695040888963407UL;
+    int j = (int) ((state >> 33) % (unsigned long) (i + 1));
+    int temp = foldOf[i];
+    foldOf[i] = foldOf[j];
+    foldOf[j] = temp;
+  }
+
+  Fold* folds = (Fold*)malloc(sizeof(Fold) * numFolds);
+  for (int k = 0; k < numFolds; k++) {
+    folds[k].numTest = 0;
+    for (int i = 0; i < numInstances; i++)
+      if (foldOf[i] == k)
+	folds[k].numTest++;
+    folds[k].numTrain = numInstances - folds[k].numTest;
+    folds[k].testRows = (int*)malloc(sizeof(int) * folds[k].numTest);
+    folds[k].trainRows = (int*)malloc(sizeof(int) * folds[k].numTrain);
+
+    int testIndex = 0;
+    int trainIndex = 0;
+    for (int i = 0; i < numInstances; i++) {
+      if (foldOf[i] == k) {
+	folds[k].testRows[testIndex] = i;
+	testIndex++;
+      } else {
+	folds[k].trainRows[trainIndex] = i;
+	trainIndex++;
+      }
+    }
+  }
+
+  free(foldOf);
+  return folds;
+}
+
+// Task: train one configuration on one fold and test it on the held-out rows
+static void runFold(void* context, int task) {
+  CrossValidation* cv = (CrossValidation*) context;
+  TrainOptions* options = &cv->configs[task / cv->numFolds];
+  Fold* fold = &cv->folds[task % cv->numFolds];
+  FoldResult* result = &cv->results[task];
+
+  double start = now();
+  DecisionTree* tree = makeTreeSorted(cv->names, cv->sorted, fold->trainRows, fold->numTrain, options);
+  result->trainSeconds = now() - start;
+  result->failed = !tree;
+  if (!tree)
+    return;
+
+  result->numCorrect = 0;
+  for (int i = 0; i < fold->numTest; i++) {
+    Instance* instance = cv->names->instances[fold->testRows[i]];
+    result->numCorrect += classWeight(instance, classify(tree, instance));
+  }
+  result->numNodes = countNodes(tree->root);
+
+  freeTree(tree->root);
+  free(tree);
+}
+
+// Runs k-fold cross-validation of every configuration on the instances
+// The features are sorted once and every fold is a view into names, so the data is never copied.
+// All (configuration, fold) pairs run concurrently on numThreads threads (<= 0 for one per processor).
+// results must have room for numConfigs entries, one per configuration in the same order.
+// Returns 0 (and leaves results unset) if the features or a fold's tree couldn't be allocated.
+_Bool crossValidate(Names* names, int numFolds, TrainOptions* configs, int numConfigs, int numThreads, unsigned int seed, CrossValidationResult* results) {
+  assert(names != NULL);
+  assert(configs != NULL);
+  assert(results != NULL);
+  assert(numFolds >= 2 && numFolds <= names->numInstances);
+  assert(numConfigs > 0);
+
+  CrossValidation cv;
+  cv.names = names;
+  cv.sorted = sortFeatures(names);
+  if (!cv.sorted)
+    return 0;
+  cv.configs = configs;
+  cv.folds = makeFolds(names->numInstances, numFolds, seed);
+  cv.numFolds = numFolds;
+  cv.results = (FoldResult*)malloc(sizeof(FoldResult) * numConfigs * numFolds);
+
+  runTasks(runFold, &cv, numConfigs * numFolds, numThreads);
+
+  _Bool failed = 0;
+  for (int task = 0; task < numConfigs * numFolds; task++)
+    failed |= cv.results[task].failed;
+
+  // Average over the folds of each configuration
+  for (int c = 0; c < numConfigs && !failed; c++) {
+    int numCorrect = 0;
+    double numNodes = 0;
+    double trainSeconds = 0;
+    for (int k = 0; k < numFolds; k++) {
+      FoldResult* result = &cv.results[c * numFolds + k];
+      numCorrect += result->numCorrect;
+      numNodes += result->numNodes;
+      trainSeconds += result->trainSeconds;
+    }
+
+    results[c].options = configs[c];
+    results[c].accuracy = (double) numCorrect / (double) totalWeight(names);
+    results[c].numNodes = numNodes / numFolds;
+    results[c].trainSeconds = trainSeconds / numFolds;
+  }
+
+  for (int k = 0; k < numFolds; k++) {
+    free(cv.folds[k].trainRows);
+    free(cv.folds[k].testRows);
+  }
+  free(cv.folds);
+  free(cv.results);
+  freeSortedFeatures(cv.sorted);
+  return !failed;
+}
+
+// Prints one line per configuration: its options, accuracy, training time and tree size
+void printCrossValidationResults(CrossValidationResult* results, int numConfigs, int numFolds) {
+  printf("%d-fold cross-validation\n", numFolds);
+  printf("%8s %8s %10s %12s %10s\n", "MaxDepth", "MinSplit", "Accuracy", "TrainTime(s)", "Nodes");
+  for (int c = 0; c < numConfigs; c++)
+    printf("%8d %8d %10lf %12lf %10.1lf\n", results[c].options.maxDepth, results[c].options.minSplit,
+	   results[c].accuracy, results[c].trainSeconds, results[c].numNodes);
+}
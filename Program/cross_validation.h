@@ -0,0 +1,18 @@
+#ifndef CROSS_VALIDATION_H_
+#define CROSS_VALIDATION_H_
+
+#include "input.h"
+#include "presort.h"
+
+// Result of cross-validating one configuration
+typedef struct CrossValidationResult {
+  TrainOptions options;
+  double accuracy;     // Mean accuracy on the held-out folds
+  double trainSeconds; // Mean wall-clock time to build the tree of one fold
+  double numNodes;     // Mean number of nodes in the trees
+} CrossValidationResult;
+
+_Bool crossValidate(Names* names, int numFolds, TrainOptions* configs, int numConfigs, int numThreads, unsigned int seed, CrossValidationResult* results);
+void printCrossValidationResults(CrossValidationResult* results, int numConfigs, int numFolds);
+
+#endif
@@ -12,13 +12,42 @@
 
 // Prints out the feature and split value of the node or the class if it is a lead node
 void printNode(DecisionTreeNode* node) {
+  printNodeTo(stdout, node);
+}
+
+// Same as printNode, but writes to the given stream
+void printNodeTo(FILE* out, DecisionTreeNode* node) {
   assert(node != NULL);
   
-  if (!(node->isLeaf)) { 
-    printf("Feature: %d Split: %lf\n", node->info.decision.feature, node->info.decision.split);
-  } else {          // Leaf Node
-    printf("Class: %d\n", node->info.class);
+  if (node->isLeaf) {  // Leaf Node
+    fprintf(out, "Class: %d\n", node->info.class);
+  } else if (node->isCategorical) {
+    // the codes that go left; the right child takes the rest
+    fprintf(out, "Feature: %d Codes:", node->info.category.feature);
+    for (int i = 0; i < node->info.category.numCodes; i++)
+      if (node->info.category.inLeft[i])
+	fprintf(out, " %d", node->info.category.minCode + i);
+    fprintf(out, "\n");
+  } else {
+    fprintf(out, "Feature: %d Split: %lf\n", node->info.decision.feature, node->info.decision.split);
+  }
+}
+
+// Returns the child of the decision node that an instance with the given value for its feature goes to
+DecisionTreeNode* childNode(DecisionTreeNode* node, double value) {
+  assert(!(node->isLeaf));
+
+  if (node->isCategorical) {
+    // jump table lookup, anything outside the table goes right
+    double code = value - node->info.category.minCode;
+    if (code >= 0 && code < node->info.category.numCodes && node->info.category.inLeft[(int) code])
+      return node->info.category.left;
+    return node->info.category.right;
   }
+
+  if (value <= node->info.decision.split)
+    return node->info.decision.left;
+  return node->info.decision.right;
 }
 
 
@@ -39,9 +68,9 @@ int majorityClass(Instance** instances, int numInstances, int numClasses){
   for (int i = 0; i < numClasses; i++)
     classCount[i] = 0;
 
-  // count classes
+  // count classes (a deduplicated instance counts once per instance it stands for)
   for (int i = 0; i < numInstances; i++)
-    classCount[instances[i]->class]++;
+    addClassWeights(instances[i], classCount, numClasses);
 
   // pick the majority
   int majClass = 0;
@@ -60,7 +89,7 @@ _Bool sameClass(Instance** instances, int numInstances){
   int class = instances[0]->class;
 
   for (int i = 0; i < numInstances; i++)
-    if (instances[i]->class != class)
+    if (instances[i]->class != class || classWeight(instances[i], class) != instances[i]->weight)
       return 0;
 
   return 1;
@@ -93,8 +122,7 @@ int classFrequency(Instance** instances, int numInstances, int class) {
  
   // for each instance
   for (int i = 0; i < numInstances; i++)
-    if (instances[i]->class == class)
-      freq++;
+    freq += classWeight(instances[i], class);
 
   return freq;
 }
@@ -168,13 +196,14 @@ void info(Instance** instances, int numInstances, int numClasses, int feature, d
 
   // keep track the number of instances and their classes that
   // would end up on the left or right of the split value for the specified feature
+  // (weighted instances count as the instances they stand for)
   for (int i = 0; i < numInstances; i++) {
     if (instances[i]->featureValues[feature] <= split) {
-      numLeft++;
-      leftClassCount[instances[i]->class]++;
+      numLeft += instances[i]->weight;
+      addClassWeights(instances[i], leftClassCount, numClasses);
     } else {
-      numRight++;
-      rightClassCount[instances[i]->class]++;
+      numRight += instances[i]->weight;
+      addClassWeights(instances[i], rightClassCount, numClasses);
     }
   }
 
@@ -222,6 +251,7 @@ double calcEntropy(Instance** instances, int numInstances, int feature, double s
   // helper function - an implementation of the info function found in Properties.pdf
   info(instances, numInstances, numClasses, feature, split, &numLeft, &infoLeft, &numRight, &infoRight);
 
+  numInstances = numLeft + numRight; // the same unless the instances are weighted
   entropy += (((double) numLeft) / numInstances) * infoLeft;   // entropy of potential left node
   entropy += (((double) numRight) / numInstances) * infoRight;  // plus entropy of potential right node
 
@@ -271,6 +301,7 @@ DecisionTreeNode* learn(Instance** instances, int numInstances, int numFeatures,
   // - a decision node, where instances will be split on a feature and split value
   // - or a leaf node, where a class will be assigned to instances
   DecisionTreeNode* node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+  node->isCategorical = 0;
 
   if (sameClass(instances, numInstances)) {
     // leaf node
@@ -328,15 +359,27 @@ DecisionTree* makeTree(Names* names) {
 
 // Returns the class that the tree gives for the instance
 int classify(DecisionTree* tree, Instance* instance) {
-  assert(tree != NULL);
   assert(instance != NULL);
+  return classifyValues(tree, instance->featureValues);
+}
+
+// Returns the class that the tree gives for a row of feature values
+int classifyValues(DecisionTree* tree, double* featureValues) {
+  assert(tree != NULL);
+  assert(featureValues != NULL);
   DecisionTreeNode* current = tree->root;
 
   // While the current node isn't a leaf node
   while (!(current->isLeaf)) {
 
+    // Categorical node: follow the child for the instance's code
+    if (current->isCategorical) {
+      current = childNode(current, featureValues[current->info.category.feature]);
+      continue;
+    }
+
     // Split on the feature and split value of the currentNode
-    if (instance->featureValues[current->info.decision.feature] <= current->info.decision.split) {
+    if (featureValues[current->info.decision.feature] <= current->info.decision.split) {
       current = current->info.decision.left;
     } else {
       current = current->info.decision.right;
@@ -349,41 +392,200 @@ int classify(DecisionTree* tree, Instance* instance) {
 
 // Classifies each instance in the list of instances with the given tree, and returns
 // the ratio of correct classifications to the number of instances in the list
+// (weighted instances count as the instances they stand for)
 double accuracy(DecisionTree* tree, Instance** instances, int numInstances) {
   assert(tree != NULL);
   assert(instances != NULL);
   assert(numInstances > 0);
   int countCorrect = 0;
+  int total = 0;
 
-  for (int i = 0; i < numInstances; i++)
-    if (classify(tree, instances[i]) == instances[i]->class)
-      countCorrect++;
+  for (int i = 0; i < numInstances; i++) {
+    countCorrect += classWeight(instances[i], classify(tree, instances[i]));
+    total += instances[i]->weight;
+  }
   
-  return (double) countCorrect / (double) numInstances;
+  return (double) countCorrect / (double) total;
 }
 
 // Prints out the nodes of the tree in order
 // Call the function with n=0
 void printTree(DecisionTreeNode* node, int n) {
+  printTreeTo(stdout, node, n);
+}
+
+// Same as printTree, but writes to the given stream
+void printTreeTo(FILE* out, DecisionTreeNode* node, int n) {
   assert(node != NULL);
 
   for (int i = 0; i < n; i++)
-    printf("| ");
-  printNode(node);
+    fprintf(out, "| ");
+  printNodeTo(out, node);
   
-  if (!(node->isLeaf)) {
-    printTree(node->info.decision.left, n+1);
-    printTree(node->info.decision.right, n+1);
+  if (node->isLeaf)
+    return;
+
+  if (node->isCategorical) {
+    printTreeTo(out, node->info.category.left, n+1);
+    printTreeTo(out, node->info.category.right, n+1);
+  } else {
+    printTreeTo(out, node->info.decision.left, n+1);
+    printTreeTo(out, node->info.decision.right, n+1);
+  }
+}
+
+// Returns the number of nodes (decision and leaf) in the tree
+int countNodes(DecisionTreeNode* node) {
+  assert(node != NULL);
+
+  if (node->isLeaf)
+    return 1;
+
+  if (node->isCategorical)
+    return 1 + countNodes(node->info.category.left) + countNodes(node->info.category.right);
+
+  return 1 + countNodes(node->info.decision.left) + countNodes(node->info.decision.right);
+}
+
+// Returns the number of levels of the tree (1 for a single leaf)
+int treeDepth(DecisionTreeNode* node) {
+  assert(node != NULL);
+  int depth = 0;
+
+  if (node->isCategorical) {
+    int leftDepth = treeDepth(node->info.category.left);
+    int rightDepth = treeDepth(node->info.category.right);
+    depth = leftDepth > rightDepth ? leftDepth : rightDepth;
+  } else if (!node->isLeaf) {
+    int leftDepth = treeDepth(node->info.decision.left);
+    int rightDepth = treeDepth(node->info.decision.right);
+    depth = leftDepth > rightDepth ? leftDepth : rightDepth;
   }
+
+  return depth + 1;
 }
 
 // Frees the nodes of the tree
 void freeTree(DecisionTreeNode* node) {
-  if (!(node->isLeaf)) {
+  if (node->isLeaf) {
+    // nothing below
+  } else if (node->isCategorical) {
+    freeTree(node->info.category.left);
+    freeTree(node->info.category.right);
+    free(node->info.category.inLeft);
+  } else {
     freeTree(node->info.decision.left);
     freeTree(node->info.decision.right);
   }
 
   free(node);
 }
-  
+
+
+
+// Saving & Loading
+
+#define MAX_LOAD_CODES 4096 // Widest jump table loadTree accepts
+
+// Writes the nodes of the tree in preorder, one per line:
+//   "L class" for a leaf, "S feature split" for a decision node (the split in hexadecimal, so it
+//   reads back exactly), and "C feature minCode numCodes table" for a categorical node, where the
+//   table has a 1 for every code that goes left and a 0 for the others. Children follow their parent, left first.
+void saveTree(FILE* file, DecisionTreeNode* node) {
+  assert(file != NULL);
+  assert(node != NULL);
+
+  if (node->isLeaf) {
+    fprintf(file, "L %d\n", node->info.class);
+  } else if (node->isCategorical) {
+    fprintf(file, "C %d %d %d ", node->info.category.feature, node->info.category.minCode, node->info.category.numCodes);
+    for (int i = 0; i < node->info.category.numCodes; i++)
+      fputc(node->info.category.inLeft[i] ? '1' : '0', file);
+    fprintf(file, "\n");
+    saveTree(file, node->info.category.left);
+    saveTree(file, node->info.category.right);
+  } else {
+    fprintf(file, "S %d %a\n", node->info.decision.feature, node->info.decision.split);
+    saveTree(file, node->info.decision.left);
+    saveTree(file, node->info.decision.right);
+  }
+}
+
+// Reads a categorical node's table of numCodes digits written by saveTree
+// Returns NULL if it is malformed
+static unsigned char* loadTable(FILE* file, int numCodes) {
+  unsigned char* inLeft = (unsigned char*)malloc(numCodes);
+  if (!inLeft || fscanf(file, " ") != 0) {
+    free(inLeft);
+    return NULL;
+  }
+  for (int i = 0; i < numCodes; i++) {
+    int digit = getc(file);
+    if (digit != '0' && digit != '1') {
+      free(inLeft);
+      return NULL;
+    }
+    inLeft[i] = digit == '1';
+  }
+  return inLeft;
+}
+
+// Reads a node and its subtree written by saveTree
+// Returns NULL, having freed what it read, if the input is malformed
+static DecisionTreeNode* loadNode(FILE* file, int numFeatures, int numClasses, int depth) {
+  char kind;
+  if (depth >= MAX_LOAD_DEPTH || fscanf(file, " %c", &kind) != 1)
+    return NULL;
+
+  DecisionTreeNode* node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+  if (!node)
+    return NULL;
+  node->isCategorical = 0;
+  node->isLeaf = kind == 'L';
+
+  if (kind == 'L') {
+    if (fscanf(file, "%d", &(node->info.class)) == 1 && node->info.class >= 0 && node->info.class < numClasses)
+      return node;
+  } else if (kind == 'S') {
+    int feature;
+    double split;
+    if (fscanf(file, "%d %lf", &feature, &split) == 2 && feature >= 0 && feature < numFeatures) {
+      node->info.decision.feature = feature;
+      node->info.decision.split = split;
+      node->info.decision.left = loadNode(file, numFeatures, numClasses, depth + 1);
+      node->info.decision.right = node->info.decision.left ? loadNode(file, numFeatures, numClasses, depth + 1) : NULL;
+      if (node->info.decision.right)
+	return node;
+      if (node->info.decision.left)
+	freeTree(node->info.decision.left);
+    }
+  } else if (kind == 'C') {
+    int feature, minCode, numCodes;
+    unsigned char* inLeft = NULL;
+    if (fscanf(file, "%d %d %d", &feature, &minCode, &numCodes) == 3 && feature >= 0 && feature < numFeatures
+	&& numCodes > 0 && numCodes <= MAX_LOAD_CODES && (inLeft = loadTable(file, numCodes)) != NULL) {
+      node->isCategorical = 1;
+      node->info.category.feature = feature;
+      node->info.category.minCode = minCode;
+      node->info.category.numCodes = numCodes;
+      node->info.category.inLeft = inLeft;
+      node->info.category.left = loadNode(file, numFeatures, numClasses, depth + 1);
+      node->info.category.right = node->info.category.left ? loadNode(file, numFeatures, numClasses, depth + 1) : NULL;
+      if (node->info.category.right)
+	return node;
+      if (node->info.category.left)
+	freeTree(node->info.category.left);
+      free(inLeft);
+    }
+  }
+
+  free(node);
+  return NULL;
+}
+
+// Reads a tree written by saveTree and checks that its features and classes are in range
+// Returns NULL if the input is malformed or the tree has more than MAX_LOAD_DEPTH levels
+DecisionTreeNode* loadTree(FILE* file, int numFeatures, int numClasses) {
+  assert(file != NULL);
+  return loadNode(file, numFeatures, numClasses, 0);
+}
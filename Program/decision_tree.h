@@ -6,6 +6,7 @@
 // Node
 typedef struct DecisionTreeNode {
   _Bool isLeaf;
+  _Bool isCategorical; // Decision node that splits the codes of a categorical feature (info.category)
   union {
     struct {
       struct DecisionTreeNode* left;  // For feature values <= the split
@@ -14,12 +15,24 @@ typedef struct DecisionTreeNode {
       double split; // The value to split at
     } decision;
 
+    // Categorical decision node: the codes of a subset go left, every other code right
+    struct {
+      struct DecisionTreeNode* left;  // For the codes in the subset
+      struct DecisionTreeNode* right; // For the other codes, including ones that weren't seen in training
+      int feature;           // The feature to split on
+      int minCode;           // Code of the first entry of the table
+      int numCodes;          // Size of the table
+      unsigned char* inLeft; // Jump table: inLeft[code - minCode] is 1 if the code is in the subset
+    } category;
+
     // Leaf Node
     int class; // The classification
   } info;
 } DecisionTreeNode;
 
 void printNode(DecisionTreeNode* node);
+void printNodeTo(FILE* out, DecisionTreeNode* node);
+DecisionTreeNode* childNode(DecisionTreeNode* node, double value);
 
 
 
@@ -30,8 +43,19 @@ typedef struct DecisionTree {
 
 DecisionTree* makeTree(Names* names);
 int classify(DecisionTree* tree, Instance* instance);
+int classifyValues(DecisionTree* tree, double* featureValues);
 double accuracy(DecisionTree* tree, Instance** instances, int numInstances);
 void printTree(DecisionTreeNode* node, int n);
+void printTreeTo(FILE* out, DecisionTreeNode* node, int n);
+int countNodes(DecisionTreeNode* node);
+int treeDepth(DecisionTreeNode* node);
 void freeTree(DecisionTreeNode* node);
 
+// Saving & Loading
+#define MAX_LOAD_DEPTH 4096 // Deepest tree loadTree accepts: every walk over a tree recurses once per level, so a
+                            // file can't make one exhaust even a small thread stack
+
+void saveTree(FILE* file, DecisionTreeNode* node);
+DecisionTreeNode* loadTree(FILE* file, int numFeatures, int numClasses);
+
 #endif
@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dtree.h"
+#include "decision_tree.h"
+#include "presort.h"
+#include "optimize.h"
+#include "quantize.h"
+#include "input.h"
+
+// The handles behind the public types
+// A dataset keeps its features sorted from the start, so concurrent trainings only read it
+struct DTreeDataset {
+  Names* names;
+  SortedFeatures* sorted;
+};
+
+struct DTreeModel {
+  DecisionTree* tree;
+  FlatTree* flat; // Hot-first layout of the tree once it's optimized, used to classify (NULL before)
+  QuantTree* quant; // Bin tables and compact layout once it's quantized (NULL before)
+  int numFeatures;
+  int numClasses;
+};
+
+// Status
+
+// Returns a short description of the status (never NULL)
+const char* dtreeStatusMessage(DTreeStatus status) {
+  switch (status) {
+  case DTREE_OK: return "ok";
+  case DTREE_ERROR_ARGUMENT: return "invalid argument";
+  case DTREE_ERROR_MEMORY: return "out of memory";
+  case DTREE_ERROR_IO: return "model file couldn't be read or written";
+  case DTREE_ERROR_FORMAT: return "malformed model file";
+  }
+  return "unknown status";
+}
+
+
+
+// Datasets
+
+// Copies the buffers into a new dataset
+// Every value is checked first, so the learners' own assertions can't fail on a dataset
+DTreeStatus dtreeDatasetCreate(const double* features, const int* classes, int numRows, int numFeatures,
+			       int numClasses, const unsigned char* categorical, DTreeDataset** dataset) {
+  if (!features || !classes || !dataset || numRows <= 0 || numFeatures <= 0 || numClasses <= 0)
+    return DTREE_ERROR_ARGUMENT;
+  *dataset = NULL;
+
+  for (long i = 0; i < (long) numRows; i++) {
+    if (classes[i] < 0 || classes[i] >= numClasses)
+      return DTREE_ERROR_ARGUMENT;
+    for (int f = 0; f < numFeatures; f++) {
+      double value = features[i * numFeatures + f];
+      if (isnan(value))
+	return DTREE_ERROR_ARGUMENT;
+      if (categorical && categorical[f] && (value != floor(value) || fabs(value) > MAX_CODE))
+	return DTREE_ERROR_ARGUMENT;
+    }
+  }
+
+  DTreeDataset* result = (DTreeDataset*)malloc(sizeof(DTreeDataset));
+  Names* names = (Names*)malloc(sizeof(Names));
+  Instance** instances = (Instance**)calloc(numRows, sizeof(Instance*));
+  _Bool* types = categorical ? (_Bool*)malloc(sizeof(_Bool) * numFeatures) : NULL;
+  if (!result || !names || !instances || (categorical && !types)) {
+    free(result);
+    free(names);
+    free(instances);
+    free(types);
+    return DTREE_ERROR_MEMORY;
+  }
+
+  names->numClasses = numClasses;
+  names->numFeatures = numFeatures;
+  names->numInstances = 0;
+  names->instances = instances;
+  names->categorical = types;
+  names->numTargets = 1;
+  names->targets = NULL;
+  for (int f = 0; categorical && f < numFeatures; f++)
+    types[f] = categorical[f] != 0;
+
+  for (int i = 0; i < numRows; i++) {
+    Instance* instance = (Instance*)malloc(sizeof(Instance));
+    double* values = (double*)malloc(sizeof(double) * numFeatures);
+    if (!instance || !values) {
+      free(instance);
+      free(values);
+      freeNames(names);
+      free(result);
+      return DTREE_ERROR_MEMORY;
+    }
+    memcpy(values, features + (long) i * numFeatures, sizeof(double) * numFeatures);
+    instance->featureValues = values;
+    instance->class = classes[i];
+    instance->weight = 1;
+    instance->classWeights = NULL;
+    instances[i] = instance;
+    names->numInstances++;
+  }
+
+  result->names = names;
+  result->sorted = sortFeatures(names);
+  if (!result->sorted) {
+    freeNames(names);
+    free(result);
+    return DTREE_ERROR_MEMORY;
+  }
+  *dataset = result;
+  return DTREE_OK;
+}
+
+// Folds rows with identical feature values into weighted rows (see deduplicateNames)
+// Trees trained afterwards are the same, but training only scans the unique rows.
+// numUnique (if not NULL) receives the number of rows left. Not safe while the dataset is training.
+// If the rows can't be sorted again (DTREE_ERROR_MEMORY), the dataset can only be freed.
+DTreeStatus dtreeDatasetDeduplicate(DTreeDataset* dataset, int* numUnique) {
+  if (!dataset || !dataset->sorted)
+    return DTREE_ERROR_ARGUMENT;
+
+  if (!deduplicateNames(dataset->names))
+    return DTREE_ERROR_MEMORY;
+  freeSortedFeatures(dataset->sorted);
+  dataset->sorted = sortFeatures(dataset->names);
+  if (!dataset->sorted)
+    return DTREE_ERROR_MEMORY;
+  if (numUnique)
+    *numUnique = dataset->names->numInstances;
+  return DTREE_OK;
+}
+
+// Frees the dataset (NULL is ignored)
+void dtreeDatasetFree(DTreeDataset* dataset) {
+  if (!dataset)
+    return;
+  if (dataset->sorted)
+    freeSortedFeatures(dataset->sorted);
+  freeNames(dataset->names);
+  free(dataset);
+}
+
+
+
+// Models
+
+// Sets the options to grow the tree until every leaf is pure or noisy
+void dtreeDefaultOptions(DTreeOptions* options) {
+  if (!options)
+    return;
+  options->maxDepth = 0;
+  options->minSplit = 0;
+  options->maxLeaves = 0;
+  options->memoryBudget = 0;
+  options->timeLimit = 0;
+}
+
+// Trains a tree on the dataset with the options (NULL for the defaults)
+DTreeStatus dtreeTrain(const DTreeDataset* dataset, const DTreeOptions* options, DTreeModel** model) {
+  if (!dataset || !dataset->sorted || !model)
+    return DTREE_ERROR_ARGUMENT;
+  *model = NULL;
+
+  TrainOptions trainOptions;
+  defaultTrainOptions(&trainOptions);
+  if (options) {
+    if (options->maxDepth < 0 || options->minSplit < 0 || options->maxLeaves < 0 || options->memoryBudget < 0
+	|| !(options->timeLimit >= 0))
+      return DTREE_ERROR_ARGUMENT;
+    trainOptions.maxDepth = options->maxDepth;
+    trainOptions.minSplit = options->minSplit;
+    trainOptions.maxLeaves = options->maxLeaves;
+    trainOptions.memoryBudget = options->memoryBudget;
+    trainOptions.timeLimit = options->timeLimit;
+  }
+
+  DTreeModel* result = (DTreeModel*)malloc(sizeof(DTreeModel));
+  if (!result)
+    return DTREE_ERROR_MEMORY;
+  result->tree = makeTreeSorted(dataset->names, dataset->sorted, NULL, 0, &trainOptions);
+  if (!result->tree) {
+    free(result);
+    return DTREE_ERROR_MEMORY;
+  }
+  result->flat = NULL;
+  result->quant = NULL;
+  result->numFeatures = dataset->names->numFeatures;
+  result->numClasses = dataset->names->numClasses;
+  *model = result;
+  return DTREE_OK;
+}
+
+// Classifies one row
+DTreeStatus dtreeClassify(const DTreeModel* model, const double* features, int* classOut) {
+  if (!model || !features || !classOut)
+    return DTREE_ERROR_ARGUMENT;
+  if (model->flat)
+    *classOut = classifyFlat(model->flat, (double*) features);
+  else
+    *classOut = classifyValues(model->tree, (double*) features);
+  return DTREE_OK;
+}
+
+// Classifies numRows rows into classes
+DTreeStatus dtreeClassifyBatch(const DTreeModel* model, const double* features, int numRows, int* classes) {
+  if (!model || !features || !classes || numRows < 0)
+    return DTREE_ERROR_ARGUMENT;
+  for (int i = 0; i < numRows; i++) {
+    double* row = (double*) features + (long) i * model->numFeatures;
+    classes[i] = model->flat ? classifyFlat(model->flat, row) : classifyValues(model->tree, row);
+  }
+  return DTREE_OK;
+}
+
+// Merges the splits whose subtrees only end in one class into leaves and lays the tree out again
+// with each node's more frequent child (on the sample rows) right after it, flipping comparisons
+// where the right child is the frequent one. Predictions don't change. sample holds numRows rows
+// (row-major, NULL if numRows is 0); the training rows or a sample of the expected inputs work best.
+// report (if not NULL) receives node counts and average path lengths before and after.
+// Changes the model, so it must not run while other threads use the model.
+DTreeStatus dtreeOptimize(DTreeModel* model, const double* sample, int numRows, DTreeOptimizeReport* report) {
+  if (!model || numRows < 0 || (numRows > 0 && !sample))
+    return DTREE_ERROR_ARGUMENT;
+
+  OptimizeReport optimizeReport;
+  if (model->flat)
+    freeFlatTree(model->flat);
+  model->flat = optimizeTree(model->tree, (double*) sample, numRows, model->numFeatures, &optimizeReport);
+
+  if (report) {
+    report->numNodesBefore = optimizeReport.numNodesBefore;
+    report->numNodesAfter = optimizeReport.numNodesAfter;
+    report->pathLengthBefore = optimizeReport.pathLengthBefore;
+    report->pathLengthAfter = optimizeReport.pathLengthAfter;
+    report->nextFractionBefore = optimizeReport.nextFractionBefore;
+    report->nextFractionAfter = optimizeReport.nextFractionAfter;
+  }
+  return DTREE_OK;
+}
+
+// Builds the model's bin tables and the layout of its tree over codes
+// Fails with DTREE_ERROR_ARGUMENT if the tree splits a feature at more than 65535 points.
+// Changes the model, so it must not run while other threads use the model.
+DTreeStatus dtreeQuantize(DTreeModel* model, int* codeBytes) {
+  if (!model)
+    return DTREE_ERROR_ARGUMENT;
+
+  if (model->quant)
+    freeQuantTree(model->quant);
+  model->quant = quantizeTree(model->tree->root, model->numFeatures);
+  if (!model->quant)
+    return DTREE_ERROR_ARGUMENT;
+  if (codeBytes)
+    *codeBytes = model->quant->codeBytes;
+  return DTREE_OK;
+}
+
+// Hands out the quantized model's cut table of one feature (see dtree.h for how codes follow from it)
+DTreeStatus dtreeQuantizeCuts(const DTreeModel* model, int feature, const double** values,
+			      const unsigned char** inclusive, int* numCuts) {
+  if (!model || !model->quant || feature < 0 || feature >= model->numFeatures || !values || !inclusive || !numCuts)
+    return DTREE_ERROR_ARGUMENT;
+  *values = model->quant->cutValues[feature];
+  *inclusive = model->quant->cutInclusive[feature];
+  *numCuts = model->quant->numCuts[feature];
+  return DTREE_OK;
+}
+
+// Turns numRows rows of feature values into codes (numRows * numFeatures codes of the quantized width)
+DTreeStatus dtreeQuantizeRows(const DTreeModel* model, const double* features, int numRows, void* codes) {
+  if (!model || !model->quant || !features || !codes || numRows < 0)
+    return DTREE_ERROR_ARGUMENT;
+  for (long i = 0; i < (long) numRows * model->numFeatures; i++)
+    if (isnan(features[i]))
+      return DTREE_ERROR_ARGUMENT;
+  quantizeRows(model->quant, (double*) features, numRows, codes);
+  return DTREE_OK;
+}
+
+// Classifies numRows rows of codes into classes
+DTreeStatus dtreeClassifyQuantized(const DTreeModel* model, const void* codes, int numRows, int* classes) {
+  if (!model || !model->quant || !codes || !classes || numRows < 0)
+    return DTREE_ERROR_ARGUMENT;
+  classifyCodesBatch(model->quant, (void*) codes, numRows, classes);
+  return DTREE_OK;
+}
+
+// Returns the number of features the model's rows have (0 for NULL)
+int dtreeNumFeatures(const DTreeModel* model) {
+  return model ? model->numFeatures : 0;
+}
+
+// Returns the number of classes the model predicts (0 for NULL)
+int dtreeNumClasses(const DTreeModel* model) {
+  return model ? model->numClasses : 0;
+}
+
+// Returns the number of nodes in the model's tree (0 for NULL)
+int dtreeNumNodes(const DTreeModel* model) {
+  return model ? countNodes(model->tree->root) : 0;
+}
+
+// Writes the model to a text file: a "dtree version" line, a "classes features" line and the tree (see saveTree)
+// Fails with DTREE_ERROR_ARGUMENT if the tree is deeper than dtreeLoad accepts (MAX_LOAD_DEPTH levels)
+DTreeStatus dtreeSave(const DTreeModel* model, const char* path) {
+  if (!model || !path || treeDepth(model->tree->root) > MAX_LOAD_DEPTH)
+    return DTREE_ERROR_ARGUMENT;
+
+  FILE* file = fopen(path, "w");
+  if (!file)
+    return DTREE_ERROR_IO;
+  fprintf(file, "dtree %d\n%d %d\n", DTREE_VERSION, model->numClasses, model->numFeatures);
+  saveTree(file, model->tree->root);
+
+  _Bool failed = ferror(file) != 0;
+  if (fclose(file) != 0 || failed)
+    return DTREE_ERROR_IO;
+  return DTREE_OK;
+}
+
+// Reads a model written by dtreeSave
+DTreeStatus dtreeLoad(const char* path, DTreeModel** model) {
+  if (!path || !model)
+    return DTREE_ERROR_ARGUMENT;
+  *model = NULL;
+
+  FILE* file = fopen(path, "r");
+  if (!file)
+    return DTREE_ERROR_IO;
+
+  int version, numClasses, numFeatures;
+  if (fscanf(file, "dtree %d %d %d", &version, &numClasses, &numFeatures) != 3
+      || version != DTREE_VERSION || numClasses <= 0 || numFeatures <= 0) {
+    fclose(file);
+    return DTREE_ERROR_FORMAT;
+  }
+
+  DecisionTreeNode* root = loadTree(file, numFeatures, numClasses);
+  _Bool failed = ferror(file) != 0;
+  fclose(file);
+  if (!root)
+    return failed ? DTREE_ERROR_IO : DTREE_ERROR_FORMAT;
+
+  DTreeModel* result = (DTreeModel*)malloc(sizeof(DTreeModel));
+  DecisionTree* tree = (DecisionTree*)malloc(sizeof(DecisionTree));
+  if (!result || !tree) {
+    free(result);
+    free(tree);
+    freeTree(root);
+    return DTREE_ERROR_MEMORY;
+  }
+  tree->root = root;
+  result->tree = tree;
+  result->flat = NULL;
+  result->quant = NULL;
+  result->numClasses = numClasses;
+  result->numFeatures = numFeatures;
+  *model = result;
+  return DTREE_OK;
+}
+
+// Prints the tree to the stream, one node per line, indented by depth (like printTree)
+DTreeStatus dtreePrint(const DTreeModel* model, FILE* out) {
+  if (!model || !out)
+    return DTREE_ERROR_ARGUMENT;
+  printTreeTo(out, model->tree->root, 0);
+  return ferror(out) ? DTREE_ERROR_IO : DTREE_OK;
+}
+
+// Frees the model (NULL is ignored)
+void dtreeModelFree(DTreeModel* model) {
+  if (!model)
+    return;
+  freeTree(model->tree->root);
+  free(model->tree);
+  if (model->flat)
+    freeFlatTree(model->flat);
+  if (model->quant)
+    freeQuantTree(model->quant);
+  free(model);
+}
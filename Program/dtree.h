@@ -0,0 +1,117 @@
+#ifndef DTREE_H_
+#define DTREE_H_
+
+// Public interface of libdtree
+// Only the functions and types declared here are part of the stable API; everything else in the
+// library may change between versions. Datasets and models are opaque handles. A model is only
+// changed by dtreeOptimize and dtreeQuantize, so otherwise any number of threads may classify with it at once, and
+// any number of threads may train on the same dataset at once. The library never prints to stdout
+// and reports bad input through the returned status instead of stopping the program. Allocation
+// failures are reported too, except for the small ones made per node while a tree grows or per row
+// while rows are folded, which (like running out of stack) still end the program.
+
+#include <stdio.h>
+
+#define DTREE_VERSION 2 // Version of this interface and of the model file format
+
+#if defined(__GNUC__)
+#define DTREE_API __attribute__((visibility("default")))
+#else
+#define DTREE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Status
+typedef enum DTreeStatus {
+  DTREE_OK = 0,
+  DTREE_ERROR_ARGUMENT, // A NULL pointer, a size out of range, a class out of range or a NaN feature value
+  DTREE_ERROR_MEMORY,   // A copy of the input, its sort orders or a training run's working buffers couldn't be allocated
+  DTREE_ERROR_IO,       // A model file couldn't be opened, read or written
+  DTREE_ERROR_FORMAT    // A model file is malformed or from another version
+} DTreeStatus;
+
+DTREE_API const char* dtreeStatusMessage(DTreeStatus status);
+
+
+
+// Datasets
+typedef struct DTreeDataset DTreeDataset;
+
+// features holds numRows rows of numFeatures values each (row-major), classes one class per row
+// in [0, numClasses). categorical (NULL if every feature is ordered) marks the features that hold
+// integer category codes. The buffers are copied, so they may be freed once this returns.
+DTREE_API DTreeStatus dtreeDatasetCreate(const double* features, const int* classes, int numRows, int numFeatures,
+					 int numClasses, const unsigned char* categorical, DTreeDataset** dataset);
+DTREE_API DTreeStatus dtreeDatasetDeduplicate(DTreeDataset* dataset, int* numUnique);
+DTREE_API void dtreeDatasetFree(DTreeDataset* dataset);
+
+
+
+// Models
+typedef struct DTreeModel DTreeModel;
+
+typedef struct DTreeOptions { // Set with dtreeDefaultOptions before changing any field
+  int maxDepth; // Nodes at this depth become leaves (the root is depth 0), 0 for no limit
+  int minSplit; // Nodes with fewer rows than this become leaves, 0 for no limit
+
+  // Budgets: if any is set, the tree grows best-first (the leaf whose split removes the most entropy
+  // next) and training stops once the next split doesn't fit or time is up, returning the tree so far
+  int maxLeaves;     // Most leaves the tree may have, 0 for no limit
+  long memoryBudget; // Most bytes the tree's nodes may take, 0 for no limit
+  double timeLimit;  // Seconds of training after which no more leaves are split, 0 for no limit
+} DTreeOptions;
+
+DTREE_API void dtreeDefaultOptions(DTreeOptions* options);
+DTREE_API DTreeStatus dtreeTrain(const DTreeDataset* dataset, const DTreeOptions* options, DTreeModel** model);
+
+// features holds one row (or numRows rows, row-major) with the model's number of features
+DTREE_API DTreeStatus dtreeClassify(const DTreeModel* model, const double* features, int* classOut);
+DTREE_API DTreeStatus dtreeClassifyBatch(const DTreeModel* model, const double* features, int numRows, int* classes);
+
+typedef struct DTreeOptimizeReport {
+  int numNodesBefore;
+  int numNodesAfter;
+  double pathLengthBefore;   // Average number of decisions a sample row takes to reach its leaf
+  double pathLengthAfter;
+  double nextFractionBefore; // Fraction of those decisions whose child is the next node in memory
+  double nextFractionAfter;
+} DTreeOptimizeReport;
+
+DTREE_API DTreeStatus dtreeOptimize(DTreeModel* model, const double* sample, int numRows, DTreeOptimizeReport* report);
+
+// Quantized inference: dtreeQuantize maps every feature onto the bins between the model's thresholds
+// for it, so rows can be turned into small integer codes once (dtreeQuantizeRows) and classified with
+// integer compares (dtreeClassifyQuantized). codeBytes receives the width of a code: 1 (unsigned char)
+// or 2 (unsigned short). Codes are row-major like features, and the classes are the same as dtreeClassify's.
+DTREE_API DTreeStatus dtreeQuantize(DTreeModel* model, int* codeBytes);
+DTREE_API DTreeStatus dtreeQuantizeRows(const DTreeModel* model, const double* features, int numRows, void* codes);
+DTREE_API DTreeStatus dtreeClassifyQuantized(const DTreeModel* model, const void* codes, int numRows, int* classes);
+
+// Gives the cut table of a feature of a quantized model, so codes can be made or read without the
+// library: values[0..numCuts) in increasing order, and inclusive[j] set where values equal to
+// values[j] count as above it (the boundaries between categorical codes; at an equal value such a cut
+// comes before an exclusive one). A value's code is the number of cuts it is above: cut j if
+// value > values[j], or value >= values[j] when inclusive[j] is set. Codes run from 0 to numCuts.
+// The arrays belong to the model and stay valid until it is quantized again or freed.
+DTREE_API DTreeStatus dtreeQuantizeCuts(const DTreeModel* model, int feature, const double** values,
+					const unsigned char** inclusive, int* numCuts);
+
+DTREE_API int dtreeNumFeatures(const DTreeModel* model);
+DTREE_API int dtreeNumClasses(const DTreeModel* model);
+DTREE_API int dtreeNumNodes(const DTreeModel* model);
+
+// Model files hold trees of at most 4096 levels: dtreeLoad rejects deeper ones as malformed, so that
+// a crafted file can't exhaust the stack, and dtreeSave refuses to write them
+DTREE_API DTreeStatus dtreeSave(const DTreeModel* model, const char* path);
+DTREE_API DTreeStatus dtreeLoad(const char* path, DTreeModel** model);
+DTREE_API DTreeStatus dtreePrint(const DTreeModel* model, FILE* out);
+DTREE_API void dtreeModelFree(DTreeModel* model);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
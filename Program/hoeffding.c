@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "hoeffding.h"
+#include "decision_tree.h"
+
+// Options
+
+// Sets the options to the usual VFDT values
+void defaultHoeffdingOptions(HoeffdingOptions* options) {
+  assert(options != NULL);
+  options->delta = 1e-7;
+  options->tieThreshold = 0.05;
+  options->gracePeriod = 200;
+  options->maxCandidates = 32;
+  options->memoryBudget = 0;
+}
+
+
+
+// Leaf Statistics
+
+// Sufficient statistics of an active leaf, allocated as one block
+// Each feature keeps, per class, the count, mean, spread and range of the values seen, so the summary
+// doesn't depend on the order the instances arrive in. The class counts left of a split are estimated
+// from a normal distribution per class, at maxCandidates points spread evenly over the values' range.
+typedef struct LeafStats {
+  int numSeen;        // Instances summarized since the leaf was created
+  int numSinceCheck;  // Instances since the last split attempt
+  int* seenCount;     // Class counts of the summarized instances
+  double* mean;       // mean[f * numClasses + class] of the feature's values for the class
+  double* m2;         // Sum of squared differences from the mean (Welford), in the same layout
+  double* min;        // Smallest and largest value, in the same layout
+  double* max;
+} LeafStats;
+
+// A node of the learner, mirroring a node of the output tree
+typedef struct HoeffdingNode {
+  DecisionTreeNode* node;      // The node in the output tree
+  struct HoeffdingNode* left;  // Children, if node is a decision node
+  struct HoeffdingNode* right;
+  int* classCount;             // Class counts of a leaf, deciding its class
+  LeafStats* stats;            // NULL for decision nodes and leaves that no longer split
+} HoeffdingNode;
+
+// Returns the number of bytes an active leaf's statistics take
+static long statsSize(HoeffdingTree* learner) {
+  long numEstimators = (long) learner->numFeatures * learner->numClasses;
+  return sizeof(LeafStats) + 4 * sizeof(double) * numEstimators + sizeof(int) * learner->numClasses;
+}
+
+// Returns the number of bytes a leaf takes besides its statistics: its node in both trees and its class counts
+static long leafSize(HoeffdingTree* learner) {
+  return sizeof(HoeffdingNode) + sizeof(DecisionTreeNode) + sizeof(int) * learner->numClasses;
+}
+
+// Allocates empty statistics, or returns NULL if they would exceed the memory budget
+static LeafStats* makeStats(HoeffdingTree* learner) {
+  long size = statsSize(learner);
+  if (learner->options.memoryBudget > 0 && learner->memoryUsed + size > learner->options.memoryBudget)
+    return NULL;
+
+  long numEstimators = (long) learner->numFeatures * learner->numClasses;
+  char* block = (char*)calloc(1, size);
+  LeafStats* stats = (LeafStats*) block;
+  block += sizeof(LeafStats);
+  stats->mean = (double*) block;
+  block += sizeof(double) * numEstimators;
+  stats->m2 = (double*) block;
+  block += sizeof(double) * numEstimators;
+  stats->min = (double*) block;
+  block += sizeof(double) * numEstimators;
+  stats->max = (double*) block;
+  block += sizeof(double) * numEstimators;
+  stats->seenCount = (int*) block;
+
+  learner->memoryUsed += size;
+  return stats;
+}
+
+// Frees a leaf's statistics and gives their bytes back to the budget
+static void freeStats(HoeffdingTree* learner, HoeffdingNode* h) {
+  if (h->stats) {
+    free(h->stats);
+    h->stats = NULL;
+    learner->memoryUsed -= statsSize(learner);
+  }
+}
+
+// Adds an instance's value for one feature to the estimator of its class
+// Must be called before the instance is added to seenCount
+static void addValue(HoeffdingTree* learner, LeafStats* stats, int feature, double value, int class) {
+  int e = feature * learner->numClasses + class;
+  int n = stats->seenCount[class] + 1;
+  double delta = value - stats->mean[e];
+  stats->mean[e] += delta / n;
+  stats->m2[e] += delta * (value - stats->mean[e]);
+  if (n == 1 || value < stats->min[e])
+    stats->min[e] = value;
+  if (n == 1 || value > stats->max[e])
+    stats->max[e] = value;
+}
+
+// Returns the estimated number of the class's instances whose value for the feature is <= split
+static double countBelow(HoeffdingTree* learner, LeafStats* stats, int feature, int class, double split) {
+  int e = feature * learner->numClasses + class;
+  int n = stats->seenCount[class];
+  if (n == 0 || split < stats->min[e])
+    return 0;
+  if (split >= stats->max[e])
+    return n;
+
+  double sd = sqrt(stats->m2[e] / (n - 1)); // min < max, so n >= 2
+  if (sd == 0)
+    return split >= stats->mean[e] ? n : 0;
+  return n * 0.5 * erfc(-(split - stats->mean[e]) / (sd * M_SQRT2));
+}
+
+// Returns the entropy of the class counts of n instances
+static double entropy(double* classCount, double n, int numClasses) {
+  double info = 0.0;
+  for (int i = 0; i < numClasses; i++) {
+    if (classCount[i] > 0) {
+      double d = classCount[i] / n;
+      info += -d * log2(d);
+    }
+  }
+  return info;
+}
+
+// Finds the candidate split of the feature that minimizes the expected entropy
+// The candidates divide the range of the feature's values evenly. Fills in the estimated class counts
+// on each side of the best split; returns 0 if no candidate splits the instances
+static _Bool bestCandidate(HoeffdingTree* learner, LeafStats* stats, int feature, double* leftCount, double* rightCount,
+			   double* splitOut, double* entropyOut) {
+  int numClasses = learner->numClasses;
+  int maxCandidates = learner->options.maxCandidates;
+  double left[numClasses];
+  double right[numClasses];
+  _Bool found = 0;
+  double minEntropy = 0.0;
+
+  // range of the values over every class seen
+  double lo = 0;
+  double hi = 0;
+  _Bool any = 0;
+  for (int c = 0; c < numClasses; c++) {
+    int e = feature * numClasses + c;
+    if (stats->seenCount[c] == 0)
+      continue;
+    if (!any || stats->min[e] < lo)
+      lo = stats->min[e];
+    if (!any || stats->max[e] > hi)
+      hi = stats->max[e];
+    any = 1;
+  }
+  if (!any || lo == hi)
+    return 0;
+
+  for (int k = 1; k <= maxCandidates; k++) {
+    double split = lo + (hi - lo) * k / (maxCandidates + 1);
+    double numLeft = 0;
+    for (int c = 0; c < numClasses; c++) {
+      left[c] = countBelow(learner, stats, feature, c, split);
+      right[c] = stats->seenCount[c] - left[c];
+      numLeft += left[c];
+    }
+    double numRight = stats->numSeen - numLeft;
+    if (numLeft <= 0 || numRight <= 0)
+      continue;
+
+    double e = (numLeft / stats->numSeen) * entropy(left, numLeft, numClasses)
+      + (numRight / stats->numSeen) * entropy(right, numRight, numClasses);
+
+    if (!found || e < minEntropy) {
+      found = 1;
+      minEntropy = e;
+      *splitOut = split;
+      memcpy(leftCount, left, sizeof(double) * numClasses);
+      memcpy(rightCount, right, sizeof(double) * numClasses);
+    }
+  }
+
+  *entropyOut = minEntropy;
+  return found;
+}
+
+// Returns a new leaf with the specified class and class counts (NULL for none)
+// The leaf itself is always charged to the budget; its statistics only if they fit
+static HoeffdingNode* makeLeafNode(HoeffdingTree* learner, int class, int* classCount) {
+  HoeffdingNode* h = (HoeffdingNode*)malloc(sizeof(HoeffdingNode));
+  h->node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+  h->node->isLeaf = 1;
+  h->node->isCategorical = 0;
+  h->node->info.class = class;
+  h->left = NULL;
+  h->right = NULL;
+  h->classCount = (int*)calloc(learner->numClasses, sizeof(int));
+  if (classCount)
+    memcpy(h->classCount, classCount, sizeof(int) * learner->numClasses);
+  learner->memoryUsed += leafSize(learner);
+  h->stats = makeStats(learner);
+  return h;
+}
+
+// Returns the class with the highest count (lowest class wins ties)
+static int majority(int* classCount, int numClasses) {
+  int majClass = 0;
+  for (int i = 1; i < numClasses; i++)
+    if (classCount[i] > classCount[majClass])
+      majClass = i;
+  return majClass;
+}
+
+// Splits the leaf if the Hoeffding bound shows its best split is better than the runner up
+static void attemptSplit(HoeffdingTree* learner, HoeffdingNode* h) {
+  int numClasses = learner->numClasses;
+  LeafStats* stats = h->stats;
+
+  // already pure
+  if (stats->seenCount[majority(stats->seenCount, numClasses)] == stats->numSeen)
+    return;
+
+  double leftCount[numClasses];
+  double rightCount[numClasses];
+  double bestLeft[numClasses];
+  double bestRight[numClasses];
+  double seen[numClasses];
+  for (int i = 0; i < numClasses; i++)
+    seen[i] = stats->seenCount[i];
+  double parentInfo = entropy(seen, stats->numSeen, numClasses);
+
+  // best and second best feature
+  int bestFeature = -1;
+  double split = 0.0;
+  double bestGain = 0.0;
+  double secondGain = 0.0;
+  for (int f = 0; f < learner->numFeatures; f++) {
+    double e = 0.0;
+    double candidate = 0.0;
+    if (!bestCandidate(learner, stats, f, leftCount, rightCount, &candidate, &e))
+      continue;
+
+    double gain = parentInfo - e;
+    if (bestFeature == -1 || gain > bestGain) {
+      secondGain = bestFeature == -1 ? 0.0 : bestGain;
+      bestGain = gain;
+      bestFeature = f;
+      split = candidate;
+      memcpy(bestLeft, leftCount, sizeof(double) * numClasses);
+      memcpy(bestRight, rightCount, sizeof(double) * numClasses);
+    } else if (gain > secondGain) {
+      secondGain = gain;
+    }
+  }
+
+  if (bestFeature == -1 || bestGain <= 0)
+    return;
+
+  // Hoeffding bound on the gain, whose range is log2(numClasses)
+  double range = log2(numClasses);
+  double epsilon = sqrt(range * range * log(1.0 / learner->options.delta) / (2.0 * stats->numSeen));
+  if (bestGain - secondGain <= epsilon && epsilon >= learner->options.tieThreshold)
+    return;
+
+  // both children and their statistics must fit once this leaf's statistics and class counts are released
+  long size = 2 * leafSize(learner) + statsSize(learner) - (long) sizeof(int) * numClasses;
+  if (learner->options.memoryBudget > 0 && learner->memoryUsed + size > learner->options.memoryBudget) {
+    freeStats(learner, h); // Out of memory: this leaf stays a leaf, and its memory goes to others
+    return;
+  }
+
+  // the children start with the estimated class counts on their side of the split
+  int left[numClasses];
+  int right[numClasses];
+  for (int i = 0; i < numClasses; i++) {
+    left[i] = (int) lround(bestLeft[i]);
+    right[i] = (int) lround(bestRight[i]);
+  }
+
+  freeStats(learner, h);
+  h->left = makeLeafNode(learner, majority(left, numClasses), left);
+  h->right = makeLeafNode(learner, majority(right, numClasses), right);
+  free(h->classCount);
+  h->classCount = NULL;
+  learner->memoryUsed -= sizeof(int) * numClasses;
+
+  // the leaf turns into a decision node in place, so its parent still points at it
+  DecisionTreeNode* node = h->node;
+  node->isLeaf = 0;
+  node->info.decision.feature = bestFeature;
+  node->info.decision.split = split;
+  node->info.decision.left = h->left->node;
+  node->info.decision.right = h->right->node;
+}
+
+
+
+// Learner
+
+// Creates a learner whose tree is a single leaf of class 0
+HoeffdingTree* makeHoeffdingTree(int numClasses, int numFeatures, HoeffdingOptions* options) {
+  assert(numClasses > 0);
+  assert(numFeatures > 0);
+  assert(options != NULL);
+  assert(options->gracePeriod > 0);
+  assert(options->maxCandidates > 1);
+
+  HoeffdingTree* learner = (HoeffdingTree*)malloc(sizeof(HoeffdingTree));
+  learner->numClasses = numClasses;
+  learner->numFeatures = numFeatures;
+  learner->options = *options;
+  learner->memoryUsed = 0;
+  learner->numInstances = 0;
+  learner->root = makeLeafNode(learner, 0, NULL);
+  learner->tree = (DecisionTree*)malloc(sizeof(DecisionTree));
+  learner->tree->root = learner->root->node;
+  return learner;
+}
+
+// Learns from one instance: updates the statistics of the leaf it reaches and splits
+// the leaf once enough instances show which split is best
+void hoeffdingUpdate(HoeffdingTree* learner, double* featureValues, int class) {
+  assert(featureValues != NULL);
+  assert(class >= 0 && class < learner->numClasses);
+  learner->numInstances++;
+
+  // Sort the instance down to a leaf, the same way classify does
+  HoeffdingNode* h = learner->root;
+  while (!(h->node->isLeaf)) {
+    if (featureValues[h->node->info.decision.feature] <= h->node->info.decision.split)
+      h = h->left;
+    else
+      h = h->right;
+  }
+
+  h->classCount[class]++;
+  if (h->classCount[class] > h->classCount[h->node->info.class])
+    h->node->info.class = class;
+
+  LeafStats* stats = h->stats;
+  if (!stats)
+    return;
+
+  for (int f = 0; f < learner->numFeatures; f++)
+    addValue(learner, stats, f, featureValues[f], class);
+  stats->numSeen++;
+  stats->seenCount[class]++;
+
+  stats->numSinceCheck++;
+  if (stats->numSinceCheck >= learner->options.gracePeriod) {
+    stats->numSinceCheck = 0;
+    attemptSplit(learner, h);
+  }
+}
+
+// Frees the learner's nodes and statistics
+static void freeHoeffdingNode(HoeffdingTree* learner, HoeffdingNode* h) {
+  if (h->left) {
+    freeHoeffdingNode(learner, h->left);
+    freeHoeffdingNode(learner, h->right);
+  }
+  freeStats(learner, h);
+  free(h->classCount);
+  free(h);
+}
+
+// Frees the learner and returns the tree it has grown, which the caller now owns
+DecisionTree* finishHoeffdingTree(HoeffdingTree* learner) {
+  assert(learner != NULL);
+  DecisionTree* tree = learner->tree;
+  freeHoeffdingNode(learner, learner->root);
+  free(learner);
+  return tree;
+}
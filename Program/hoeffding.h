@@ -0,0 +1,38 @@
+#ifndef HOEFFDING_H_
+#define HOEFFDING_H_
+
+#include "decision_tree.h"
+
+// Options
+typedef struct HoeffdingOptions {
+  double delta;        // Allowed probability that a split is not the best one the full stream would pick
+  double tieThreshold; // Split on the current best anyway once the Hoeffding bound drops below this
+  int gracePeriod;     // Instances a leaf sees between split attempts
+  int maxCandidates;   // Split values tried per feature, spread evenly over the range of values a leaf has seen
+  long memoryBudget;   // Bytes of nodes and leaf statistics allowed, 0 for no limit
+} HoeffdingOptions;
+
+void defaultHoeffdingOptions(HoeffdingOptions* options);
+
+
+
+// Learner
+struct HoeffdingNode;
+
+typedef struct HoeffdingTree {
+  DecisionTree* tree; // Always a valid tree, so classify can be called between updates
+
+  int numClasses;
+  int numFeatures;
+  HoeffdingOptions options;
+
+  struct HoeffdingNode* root; // Mirrors tree, holding the statistics of the leaves
+  long memoryUsed;            // Bytes of nodes and leaf statistics currently allocated
+  long numInstances;          // Instances seen so far
+} HoeffdingTree;
+
+HoeffdingTree* makeHoeffdingTree(int numClasses, int numFeatures, HoeffdingOptions* options);
+void hoeffdingUpdate(HoeffdingTree* learner, double* featureValues, int class);
+DecisionTree* finishHoeffdingTree(HoeffdingTree* learner);
+
+#endif
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <math.h>
 #include "input.h"
 
 // Instance
@@ -11,14 +13,34 @@ void printInstance(Instance* instance, int numFeatures) {
   for (int i = 0; i < numFeatures; i++)
     printf("%lf ", instance->featureValues[i]);
   printf("Class: %d", instance->class);
+  if (instance->weight != 1)
+    printf(" Weight: %d", instance->weight);
 }
 
-// Frees the array inside of the instance, and then frees the instance itself
+// Frees the arrays inside of the instance, and then frees the instance itself
 void freeInstance(Instance* instance) {
   free(instance->featureValues);
+  free(instance->classWeights);
   free(instance);
 }
 
+// Returns how many of the instances this one stands for have the class
+int classWeight(Instance* instance, int class) {
+  if (instance->classWeights)
+    return instance->classWeights[class];
+  return instance->class == class;
+}
+
+// Adds the classes of the instances this one stands for to the class counts
+void addClassWeights(Instance* instance, int* classCount, int numClasses) {
+  if (instance->classWeights) {
+    for (int i = 0; i < numClasses; i++)
+      classCount[i] += instance->classWeights[i];
+  } else {
+    classCount[instance->class]++;
+  }
+}
+
 
 
 // List
@@ -93,9 +115,333 @@ void printNames(Names* names) {
 
   printf("Features\n");
   for (int i = 0; i < names->numFeatures; i++)
-    printf("%d ", i);
+    printf(names->categorical && names->categorical[i] ? "%d(categorical) " : "%d ", i);
   printf("\n\n");
 
   printf("Instances\n");
   printInstances(names->instances, names->numInstances, names->numFeatures);
 }
+
+// Returns the number of instances the names stand for, counting duplicates folded into weights
+int totalWeight(Names* names) {
+  int total = 0;
+  for (int i = 0; i < names->numInstances; i++)
+    total += names->instances[i]->weight;
+  return total;
+}
+
+// Returns the FNV-1a hash of an instance's feature values
+static unsigned long hashFeatures(double* featureValues, int numFeatures) {
+  unsigned char* bytes = (unsigned char*) featureValues;
+  unsigned long hash = 14695981039346656037UL;
+  for (unsigned long i = 0; i < sizeof(double) * numFeatures; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211UL;
+  }
+  return hash;
+}
+
+// Folds instances with identical feature values into one weighted instance
+// The first occurrence is kept, in its original position, and counts the classes of all its
+// duplicates in classWeights; the duplicates are freed. Since only identical instances are
+// merged, the trees built on the weighted instances are the same as on the original ones.
+// Returns 0, leaving the names as they were, if the hash table can't be allocated
+_Bool deduplicateNames(Names* names) {
+  assert(names != NULL);
+  assert(names->targets == NULL); // Weights only count the classes of one target
+  int numFeatures = names->numFeatures;
+  int numClasses = names->numClasses;
+
+  // open addressing table of unique instance indices, at most half full
+  int tableSize = 1;
+  while (tableSize < 2 * names->numInstances)
+    tableSize *= 2;
+  int* table = (int*)malloc(sizeof(int) * tableSize);
+  if (!table)
+    return 0;
+  for (int i = 0; i < tableSize; i++)
+    table[i] = -1;
+
+  int numUnique = 0;
+  for (int i = 0; i < names->numInstances; i++) {
+    Instance* instance = names->instances[i];
+    unsigned long slot = hashFeatures(instance->featureValues, numFeatures) & (tableSize - 1);
+
+    // find the unique instance with the same feature values, or an empty slot
+    while (table[slot] != -1 &&
+	   memcmp(names->instances[table[slot]]->featureValues, instance->featureValues, sizeof(double) * numFeatures) != 0)
+      slot = (slot + 1) & (tableSize - 1);
+
+    if (table[slot] == -1) {
+      // first occurrence
+      table[slot] = numUnique;
+      names->instances[numUnique] = instance;
+      numUnique++;
+    } else {
+      // duplicate: fold it into the first occurrence
+      Instance* unique = names->instances[table[slot]];
+      if (!unique->classWeights) {
+	unique->classWeights = (int*)calloc(numClasses, sizeof(int));
+	unique->classWeights[unique->class] = unique->weight;
+      }
+      addClassWeights(instance, unique->classWeights, numClasses);
+      unique->weight += instance->weight;
+      freeInstance(instance);
+    }
+  }
+
+  free(table);
+  names->numInstances = numUnique;
+  return 1;
+}
+
+// Frees the instances, the feature types, the target columns and the names structure itself
+void freeNames(Names* names) {
+  freeArrayAndInstances(names->instances, names->numInstances);
+  free(names->categorical);
+  for (int t = 0; names->targets && t < names->numTargets; t++)
+    free(names->targets[t]);
+  free(names->targets);
+  free(names);
+}
+
+
+
+// Reading
+// Reads the comma separated numbers on the line into values and returns how many were read
+static int parseNumbers(char* line, double* values) {
+  char* end;
+  int index = 0; // Keep track of number of numbers read in
+
+  // Skip a UTF-8 byte order mark some editors leave at the start of a line
+  if ((unsigned char) line[0] == 0xEF && (unsigned char) line[1] == 0xBB && (unsigned char) line[2] == 0xBF)
+    line += 3;
+
+  // Read each number
+  while (index < BUFFER_SIZE) {
+    double d = strtod(line, &end);
+    if (end == line)
+      break;
+    values[index] = d;
+    index++;
+    line = end;
+    if (*line == ',')
+      line++;
+  }
+
+  return index;
+}
+
+// Creates an instance from a line of feature values followed by its class
+// Returns NULL if the line is blank
+Instance* parseInstance(char* line, int numFeatures, int numClasses) {
+  return parseInstanceTargets(line, numFeatures, numClasses, NULL, 1);
+}
+
+// Creates an instance from a line of feature values followed by its class for each of numTargets targets
+// The instance's class is the first one, and targets (if not NULL) receives all of them.
+// Returns NULL if the line is blank
+Instance* parseInstanceTargets(char* line, int numFeatures, int numClasses, int* targets, int numTargets) {
+  assert(numFeatures + numTargets <= BUFFER_SIZE); // Dense lines hold at most BUFFER_SIZE numbers
+  double temp[BUFFER_SIZE]; // Temporary array until we know the total size of the line
+  int count = parseNumbers(line, temp);
+  if (count == 0 && strspn(line, " \t\r\n") == strlen(line))
+    return NULL;
+  assert(count >= numFeatures + numTargets);
+
+  Instance* instance = (Instance*)malloc(sizeof(Instance)); // Make an instance
+  instance->featureValues = (double*)malloc(numFeatures * sizeof(double));
+
+  for (int i = 0; i < numFeatures; i++) // Copy data
+    instance->featureValues[i] = temp[i];
+
+  instance->class = (int) temp[numFeatures];
+  assert(instance->class < numClasses && instance->class >= 0);
+  for (int t = 0; targets && t < numTargets; t++) {
+    targets[t] = (int) temp[numFeatures + t];
+    assert(targets[t] < numClasses && targets[t] >= 0);
+  }
+  instance->weight = 1;
+  instance->classWeights = NULL;
+
+  return instance;
+}
+
+// Reads the feature types line of a training file: one letter per feature, 'c' for a
+// categorical feature and 'n' for a numeric (ordered) one, e.g. "types: c, c, n"
+static _Bool* parseTypes(char* text, int numFeatures) {
+  _Bool* categorical = (_Bool*)calloc(numFeatures, sizeof(_Bool));
+  int feature = 0;
+  for (; *text && feature < numFeatures; text++) {
+    if (*text == 'c' || *text == 'n') {
+      categorical[feature] = *text == 'c';
+      feature++;
+    }
+  }
+  assert(feature == numFeatures);
+  return categorical;
+}
+
+// Parses the first line of a training file: the number of classes, the number of features and,
+// optionally, the number of targets (label columns, 1 if not given)
+// Returns 0 if the line holds fewer than two numbers, so it isn't a header
+_Bool parseHeader(char* line, int* numClassesOut, int* numFeaturesOut, int* numTargetsOut) {
+  double temp[BUFFER_SIZE];
+  int count = parseNumbers(line, temp);
+  if (count < 2)
+    return 0;
+  *numClassesOut = (int) temp[0];
+  *numFeaturesOut = (int) temp[1];
+  *numTargetsOut = count >= 3 ? (int) temp[2] : 1;
+  return 1;
+}
+
+// Reads the first line of a training file (see parseHeader)
+void readHeader(FILE* file, int* numClassesOut, int* numFeaturesOut, int* numTargetsOut) {
+  assert(file != NULL);
+  char line[BUFFER_SIZE];
+  int numClasses = 0;
+  int numFeatures = 0;
+  int numTargets = 1;
+
+  if (fgets(line, sizeof(line), file))
+    parseHeader(line, &numClasses, &numFeatures, &numTargets);
+  assert(numClasses > 0);
+  assert(numFeatures > 0);
+  assert(numTargets > 0);
+
+  *numClassesOut = numClasses;
+  *numFeaturesOut = numFeatures;
+  *numTargetsOut = numTargets;
+}
+
+// Returns 1 if the line is a feature types line (see parseTypes), which may follow the first line of a training file
+_Bool isTypesLine(char* line) {
+  return strncmp(line, "types:", 6) == 0;
+}
+
+// Reads a training file (the classes & features line followed by the instances) into a Names structure
+Names* readNames(FILE* file) {
+  assert(file != NULL);
+  char line[BUFFER_SIZE]; // Read each line in file into here
+
+  Names* names = (Names*)malloc(sizeof(Names)); // Where all the input data will be stored
+  names->numInstances = 0;
+  names->categorical = NULL;
+  names->targets = NULL;
+
+  // Classes & Features (& Targets)
+  readHeader(file, &(names->numClasses), &(names->numFeatures), &(names->numTargets));
+
+  // Classes of every target, in file order, while the instances are read
+  int numTargets = names->numTargets;
+  int capacityTargets = 64;
+  int* lineTargets = NULL;
+  if (numTargets > 1)
+    lineTargets = (int*)malloc(sizeof(int) * capacityTargets * numTargets);
+
+  // Instances
+  InstanceListNode* instancesList = NULL;
+  while (fgets(line, sizeof(line), file)) {
+    // Optional feature types line before the first instance
+    if (names->numInstances == 0 && names->categorical == NULL && isTypesLine(line)) {
+      names->categorical = parseTypes(line + 6, names->numFeatures);
+      continue;
+    }
+
+    if (lineTargets && names->numInstances == capacityTargets) {
+      capacityTargets *= 2;
+      lineTargets = (int*)realloc(lineTargets, sizeof(int) * capacityTargets * numTargets);
+    }
+
+    int* instanceTargets = lineTargets ? lineTargets + names->numInstances * numTargets : NULL;
+    Instance* instance = parseInstanceTargets(line, names->numFeatures, names->numClasses, instanceTargets, numTargets);
+    if (!instance)
+      continue; // Blank line (e.g. at the end of the file)
+
+    push(&(instancesList), instance); // Add to front of linked list
+    names->numInstances++; // Keep track of number of instances
+  }
+
+  // Linked list to array
+  names->instances = (Instance**)malloc(sizeof(Instance*) * names->numInstances);
+  InstanceListNode* current = instancesList;
+  int index = 0;
+  while (current) {
+    names->instances[index] = current->instance;
+    current = current->next;
+    index++;
+  }
+  freeList(instancesList);
+
+  // Target columns, in the same (reversed) order as the array
+  if (lineTargets) {
+    names->targets = (int**)malloc(sizeof(int*) * numTargets);
+    for (int t = 0; t < numTargets; t++) {
+      names->targets[t] = (int*)malloc(sizeof(int) * (names->numInstances > 0 ? names->numInstances : 1));
+      for (int i = 0; i < names->numInstances; i++)
+	names->targets[t][i] = lineTargets[(names->numInstances - 1 - i) * numTargets + t];
+    }
+    free(lineTargets);
+  }
+
+  return names;
+}
+
+// Reads the feature types from the FEATURES section of an .info file (see data/cars.info)
+// Each line that doesn't contain "->" names the next feature, and the "code -> meaning" lines
+// after it make it categorical. A name ending in "[numeric]" or "[categorical]" says so explicitly.
+// Returns the number of features described, which should be numFeatures
+int readFeatureTypes(FILE* infoFile, _Bool* categorical, int numFeatures) {
+  assert(infoFile != NULL);
+  assert(categorical != NULL);
+  char line[BUFFER_SIZE];
+  _Bool inFeatures = 0;
+  _Bool explicitType = 0; // The current feature's type was given in its name
+  int feature = -1; // The feature being described
+
+  while (fgets(line, sizeof(line), infoFile)) {
+    line[strcspn(line, "\r\n")] = '\0';
+
+    if (!inFeatures) {
+      inFeatures = strncmp(line, "FEATURES", 8) == 0;
+      continue;
+    }
+
+    // skip blank lines and underlines
+    if (strspn(line, " \t-") == strlen(line))
+      continue;
+
+    if (strstr(line, "->")) {
+      // a code of the current feature
+      if (feature >= 0 && feature < numFeatures && !explicitType)
+	categorical[feature] = 1;
+    } else {
+      // the name of the next feature
+      feature++;
+      explicitType = strstr(line, "[numeric]") || strstr(line, "[categorical]");
+      if (feature < numFeatures)
+	categorical[feature] = strstr(line, "[categorical]") != NULL;
+    }
+  }
+
+  return feature + 1;
+}
+
+// Returns the first categorical feature with a value that isn't an integer code of at most MAX_CODE
+// in magnitude, or -1 if every code is valid. instance receives the index of the instance holding it.
+// The tree builders send each code to its own child, so they must only run on names that pass this check
+int findInvalidCode(Names* names, int* instance) {
+  assert(names != NULL);
+  if (!names->categorical)
+    return -1;
+  for (int i = 0; i < names->numInstances; i++)
+    for (int f = 0; f < names->numFeatures; f++) {
+      double value = names->instances[i]->featureValues[f];
+      if (names->categorical[f] && (value != floor(value) || fabs(value) > MAX_CODE)) {
+	*instance = i;
+	return f;
+      }
+    }
+  return -1;
+}
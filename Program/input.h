@@ -1,14 +1,24 @@
 #ifndef INSTANCE_H_
 #define INSTANCE_H_
 
+#include <stdio.h>
+
+#define BUFFER_SIZE 1024 // Longest line (and most numbers on a line) the readers accept
+#define MAX_CODE 1e9 // Largest category code magnitude accepted, so codes fit in an int
+
 // Instance
 typedef struct Instance {
   int class;
   double* featureValues;
+
+  int weight; // Number of identical instances this one stands for (1 unless deduplicated)
+  int* classWeights; // classWeights[c] of them have class c (NULL if weight is 1)
 } Instance;
 
 void printInstance(Instance* instance, int numFeatures);
 void freeInstance(Instance* instance);
+int classWeight(Instance* instance, int class);
+void addClassWeights(Instance* instance, int* classCount, int numClasses);
 
 
 
@@ -37,8 +47,29 @@ typedef struct Names { // Where all input data is held
 
   int numInstances; // Number of instances
   Instance** instances; // Array of instances
+
+  // categorical[f] is 1 if feature f holds category codes rather than ordered values (NULL if all are ordered)
+  _Bool* categorical;
+
+  // Label columns: targets[t][i] is the class of instance i for target t (NULL if there is only one,
+  // the instances' class). Every instance's class is its class for target 0.
+  int numTargets;
+  int** targets;
 } Names;
 
 void printNames(Names* names);
+void freeNames(Names* names);
+int totalWeight(Names* names);
+_Bool deduplicateNames(Names* names);
+
+// Reading
+Instance* parseInstance(char* line, int numFeatures, int numClasses);
+Instance* parseInstanceTargets(char* line, int numFeatures, int numClasses, int* targets, int numTargets);
+_Bool parseHeader(char* line, int* numClassesOut, int* numFeaturesOut, int* numTargetsOut);
+void readHeader(FILE* file, int* numClassesOut, int* numFeaturesOut, int* numTargetsOut);
+_Bool isTypesLine(char* line);
+Names* readNames(FILE* file);
+int readFeatureTypes(FILE* infoFile, _Bool* categorical, int numFeatures);
+int findInvalidCode(Names* names, int* instance);
 
 #endif
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "model_cache.h"
+#include "dtree.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#define HASH_CHUNK 65536 // Bytes of a file hashed at a time
+#define MAX_PATH 4096
+#define STALE_SECONDS 3600 // Age after which a temporary file is taken to be left over from a crashed run
+
+// Key
+
+// Starts a key with the cache and model format versions, so entries of other versions never match
+void cacheKeyInit(CacheKey* key) {
+  assert(key != NULL);
+  int versions[2] = { MODEL_CACHE_VERSION, DTREE_VERSION };
+  *key = FNV_OFFSET;
+  cacheKeyAdd(key, versions, sizeof(versions));
+}
+
+// Adds the bytes to the key
+void cacheKeyAdd(CacheKey* key, const void* data, size_t size) {
+  const unsigned char* bytes = (const unsigned char*) data;
+  for (size_t i = 0; i < size; i++) {
+    *key ^= bytes[i];
+    *key *= FNV_PRIME;
+  }
+}
+
+// Adds the rest of the file's contents and their length to the key, then rewinds the file
+// Returns 0 if the file couldn't be read
+_Bool cacheKeyAddFile(CacheKey* key, FILE* file) {
+  assert(file != NULL);
+  unsigned char* buffer = (unsigned char*)malloc(HASH_CHUNK);
+  long length = 0;
+  size_t n;
+  while ((n = fread(buffer, 1, HASH_CHUNK, file)) > 0) {
+    cacheKeyAdd(key, buffer, n);
+    length += n;
+  }
+  free(buffer);
+  cacheKeyAdd(key, &length, sizeof(length));
+
+  _Bool failed = ferror(file) != 0;
+  rewind(file);
+  return !failed;
+}
+
+
+
+// Cache
+
+// Writes the path of the key's entry in the cache directory into path
+void cachePath(const char* directory, CacheKey key, char* path, size_t size) {
+  snprintf(path, size, "%s/%016llx.model", directory, key);
+}
+
+// Returns the tree stored under the key, or NULL if there is none
+// A hit marks the entry as just used, so eviction keeps it longest. An entry that can't be
+// parsed (e.g. cut short by a crash) is removed.
+DTreeModel* cacheLoad(const char* directory, CacheKey key) {
+  assert(directory != NULL);
+  char path[MAX_PATH];
+  cachePath(directory, key, path, sizeof(path));
+
+  DTreeModel* model;
+  DTreeStatus status = dtreeLoad(path, &model);
+  if (status == DTREE_ERROR_FORMAT)
+    remove(path);
+  if (status != DTREE_OK)
+    return NULL;
+
+  utime(path, NULL);
+  return model;
+}
+
+// An entry of the cache directory, used to evict the least recently used ones first
+typedef struct CacheEntry {
+  char name[256];
+  long size;
+  double used; // Modification time in seconds, set on every store and hit
+} CacheEntry;
+
+// qsort comparator: least recently used first, then by name
+static int compareCacheEntry(const void* a, const void* b) {
+  const CacheEntry* x = (const CacheEntry*) a;
+  const CacheEntry* y = (const CacheEntry*) b;
+  if (x->used != y->used)
+    return x->used < y->used ? -1 : 1;
+  return strcmp(x->name, y->name);
+}
+
+// Returns 1 if the file name is that of a cache entry
+static _Bool isEntryName(const char* name) {
+  size_t length = strlen(name);
+  return length == 16 + strlen(".model") && strcmp(name + 16, ".model") == 0;
+}
+
+// Returns 1 if the file name is that of an entry's temporary file (see cacheStore)
+static _Bool isTemporaryName(const char* name) {
+  size_t length = strlen(name);
+  return length > 16 + strlen(".model.") + strlen(".tmp") && strncmp(name + 16, ".model.", 7) == 0
+    && strcmp(name + length - 4, ".tmp") == 0;
+}
+
+// Removes the temporary files older than STALE_SECONDS, which runs that crashed before renaming them
+// left behind, then the least recently used entries until the entries take at most maxBytes (0 for no
+// limit), never removing keep
+static void evict(const char* directory, long maxBytes, const char* keep) {
+  DIR* dir = opendir(directory);
+  if (!dir)
+    return;
+
+  int capacity = 64;
+  int numEntries = 0;
+  long total = 0;
+  CacheEntry* entries = (CacheEntry*)malloc(sizeof(CacheEntry) * capacity);
+  char path[MAX_PATH];
+  struct dirent* file;
+  while ((file = readdir(dir)) != NULL) {
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s", directory, file->d_name);
+    if (isTemporaryName(file->d_name) && stat(path, &info) == 0 && time(NULL) - info.st_mtime > STALE_SECONDS)
+      remove(path);
+    if (!isEntryName(file->d_name) || stat(path, &info) != 0)
+      continue;
+    if (numEntries == capacity) {
+      capacity *= 2;
+      entries = (CacheEntry*)realloc(entries, sizeof(CacheEntry) * capacity);
+    }
+    snprintf(entries[numEntries].name, sizeof(entries[numEntries].name), "%s", file->d_name);
+    entries[numEntries].size = (long) info.st_size;
+    entries[numEntries].used = info.st_mtim.tv_sec + info.st_mtim.tv_nsec * 1e-9;
+    total += entries[numEntries].size;
+    numEntries++;
+  }
+  closedir(dir);
+
+  qsort(entries, numEntries, sizeof(CacheEntry), compareCacheEntry);
+  for (int i = 0; maxBytes > 0 && i < numEntries && total > maxBytes; i++) {
+    if (strcmp(entries[i].name, keep) == 0)
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", directory, entries[i].name);
+    if (remove(path) == 0)
+      total -= entries[i].size;
+  }
+  free(entries);
+}
+
+// Stores the model under the key, creating the directory if needed, then evicts the least recently
+// used entries while the cache holds more than maxBytes (0 for no limit). The entry is written to a
+// temporary file first and renamed into place, so concurrent runs never read a partial entry; stale
+// temporary files of crashed runs are removed on every store.
+// Returns 0 if the entry couldn't be written.
+_Bool cacheStore(const char* directory, CacheKey key, DTreeModel* model, long maxBytes) {
+  assert(directory != NULL);
+  assert(model != NULL);
+  if (mkdir(directory, 0777) != 0 && errno != EEXIST)
+    return 0;
+
+  char path[MAX_PATH];
+  char temporary[MAX_PATH + 32];
+  cachePath(directory, key, path, sizeof(path));
+  snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long) getpid());
+  if (dtreeSave(model, temporary) != DTREE_OK || rename(temporary, path) != 0) {
+    remove(temporary);
+    return 0;
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.model", key);
+  evict(directory, maxBytes, name);
+  return 1;
+}
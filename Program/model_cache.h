@@ -0,0 +1,24 @@
+#ifndef MODEL_CACHE_H_
+#define MODEL_CACHE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include "dtree.h"
+
+#define MODEL_CACHE_VERSION 2 // Part of every key; bump it whenever training can build a different tree from the same input
+
+// Key
+typedef unsigned long long CacheKey; // 64-bit FNV-1a hash of everything a trained tree depends on
+
+void cacheKeyInit(CacheKey* key);
+void cacheKeyAdd(CacheKey* key, const void* data, size_t size);
+_Bool cacheKeyAddFile(CacheKey* key, FILE* file);
+
+
+
+// Cache
+DTreeModel* cacheLoad(const char* directory, CacheKey key);
+_Bool cacheStore(const char* directory, CacheKey key, DTreeModel* model, long maxBytes);
+void cachePath(const char* directory, CacheKey key, char* path, size_t size);
+
+#endif
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "optimize.h"
+#include "decision_tree.h"
+
+// Flat Tree
+
+// Counts the nodes and jump table entries of the subtree
+static void measureTree(DecisionTreeNode* node, int* numNodes, int* numLinks) {
+  (*numNodes)++;
+  if (node->isLeaf)
+    return;
+
+  if (node->isCategorical) {
+    *numLinks += node->info.category.numCodes + 1;
+    measureTree(node->info.category.left, numNodes, numLinks);
+    measureTree(node->info.category.right, numNodes, numLinks);
+  } else {
+    measureTree(node->info.decision.left, numNodes, numLinks);
+    measureTree(node->info.decision.right, numNodes, numLinks);
+  }
+}
+
+// Returns an empty flat tree with room for the given number of nodes and jump table entries
+static FlatTree* allocFlatTree(int numNodes, int numLinks) {
+  FlatTree* flat = (FlatTree*)malloc(sizeof(FlatTree));
+  flat->nodes = (FlatNode*)malloc(sizeof(FlatNode) * numNodes);
+  flat->links = (int*)malloc(sizeof(int) * (numLinks > 0 ? numLinks : 1));
+  flat->numNodes = 0;
+  flat->numLinks = 0;
+  return flat;
+}
+
+// Appends the node and its subtree in preorder, left child first, and returns its index
+static int appendNode(FlatTree* flat, DecisionTreeNode* node) {
+  int index = flat->numNodes;
+  flat->numNodes++;
+  FlatNode* out = &flat->nodes[index];
+  out->feature = -1;
+  out->numCodes = 0;
+  out->split = 0.0;
+
+  if (node->isLeaf) {
+    out->kind = FLAT_LEAF;
+    out->value = node->info.class;
+  } else if (node->isCategorical) {
+    // the table holds the child of every code, then the child for codes outside it
+    int numCodes = node->info.category.numCodes;
+    int table = flat->numLinks;
+    flat->numLinks += numCodes + 1;
+    out->kind = FLAT_CATEGORY;
+    out->feature = node->info.category.feature;
+    out->value = table;
+    out->numCodes = numCodes;
+    out->split = node->info.category.minCode;
+
+    int left = appendNode(flat, node->info.category.left);
+    int right = appendNode(flat, node->info.category.right);
+    for (int i = 0; i < numCodes; i++)
+      flat->links[table + i] = node->info.category.inLeft[i] ? left : right;
+    flat->links[table + numCodes] = right;
+  } else {
+    out->kind = FLAT_HOT_LEFT;
+    out->feature = node->info.decision.feature;
+    out->split = node->info.decision.split;
+    appendNode(flat, node->info.decision.left);
+    out->value = appendNode(flat, node->info.decision.right);
+  }
+
+  return index;
+}
+
+// Lays the tree out in one array, in preorder with the left child next to its parent
+FlatTree* flattenTree(DecisionTreeNode* root) {
+  assert(root != NULL);
+  int numNodes = 0;
+  int numLinks = 0;
+  measureTree(root, &numNodes, &numLinks);
+
+  FlatTree* flat = allocFlatTree(numNodes, numLinks);
+  appendNode(flat, root);
+  return flat;
+}
+
+// Returns the index of the child of a flat decision node that a row with the given value goes to
+static inline int flatChild(FlatTree* flat, int index, double value) {
+  FlatNode* node = &flat->nodes[index];
+
+  if (node->kind == FLAT_CATEGORY) {
+    double code = value - node->split;
+    int* table = flat->links + node->value;
+    if (code >= 0 && code < node->numCodes)
+      return table[(int) code];
+    return table[node->numCodes];
+  }
+
+  // the hot child is the next node, so the likely outcome is the one that doesn't jump
+  if ((value <= node->split) == (node->kind == FLAT_HOT_LEFT))
+    return index + 1;
+  return node->value;
+}
+
+// Returns the class that the flat tree gives for a row of feature values (the same as classify)
+int classifyFlat(FlatTree* flat, double* featureValues) {
+  assert(flat != NULL);
+  assert(featureValues != NULL);
+  int index = 0;
+  while (flat->nodes[index].kind != FLAT_LEAF)
+    index = flatChild(flat, index, featureValues[flat->nodes[index].feature]);
+  return flat->nodes[index].value;
+}
+
+// Frees the arrays and the structure itself
+void freeFlatTree(FlatTree* flat) {
+  free(flat->nodes);
+  free(flat->links);
+  free(flat);
+}
+
+
+
+// Optimizer
+
+// Runs the sample rows through the flat tree, adding up the visits of each node in counts (if not NULL),
+// the decision steps taken and how many of them went to the next node in the array
+static void profileFlat(FlatTree* flat, double* sample, int numRows, int numFeatures, long* counts, long* numSteps, long* numNext) {
+  *numSteps = 0;
+  *numNext = 0;
+  for (int r = 0; r < numRows; r++) {
+    double* row = sample + (long) r * numFeatures;
+    int index = 0;
+    while (1) {
+      if (counts)
+	counts[index]++;
+      if (flat->nodes[index].kind == FLAT_LEAF)
+	break;
+      int next = flatChild(flat, index, row[flat->nodes[index].feature]);
+      (*numSteps)++;
+      if (next == index + 1)
+	(*numNext)++;
+      index = next;
+    }
+  }
+}
+
+// Appends node index of the old layout (laid out left first) and its subtree to flat with the most visited child first,
+// flipping the comparison of nodes whose right child is hotter, and returns the node's new index
+static int appendHot(FlatTree* old, long* counts, FlatTree* flat, int index) {
+  FlatNode* node = &old->nodes[index];
+  int newIndex = flat->numNodes;
+  flat->numNodes++;
+  flat->nodes[newIndex] = *node;
+
+  if (node->kind == FLAT_CATEGORY) {
+    // the hotter child first, the jump table mapped to the new positions
+    int numCodes = node->numCodes;
+    int* oldTable = old->links + node->value;
+    int table = flat->numLinks;
+    flat->numLinks += numCodes + 1;
+    flat->nodes[newIndex].value = table;
+
+    // old is laid out left first, and the right child is the table's last entry
+    int left = index + 1;
+    int right = oldTable[numCodes];
+    _Bool hotLeft = counts[left] >= counts[right];
+
+    int first = appendHot(old, counts, flat, hotLeft ? left : right);
+    int second = appendHot(old, counts, flat, hotLeft ? right : left);
+    int newLeft = hotLeft ? first : second;
+    int newRight = hotLeft ? second : first;
+    for (int i = 0; i <= numCodes; i++)
+      flat->links[table + i] = oldTable[i] == left ? newLeft : newRight;
+  } else if (node->kind != FLAT_LEAF) {
+    int left = node->kind == FLAT_HOT_LEFT ? index + 1 : node->value;
+    int right = node->kind == FLAT_HOT_LEFT ? node->value : index + 1;
+    _Bool hotLeft = counts[left] >= counts[right];
+
+    appendHot(old, counts, flat, hotLeft ? left : right);
+    int cold = appendHot(old, counts, flat, hotLeft ? right : left);
+    flat->nodes[newIndex].kind = hotLeft ? FLAT_HOT_LEFT : FLAT_HOT_RIGHT;
+    flat->nodes[newIndex].value = cold;
+  }
+
+  return newIndex;
+}
+
+// Turns every decision node whose subtree only ends in leaves of one class into a leaf of that class
+// Works bottom up, so nested redundant splits collapse all the way. Returns the number of nodes removed
+int collapseTree(DecisionTreeNode* node) {
+  assert(node != NULL);
+  if (node->isLeaf)
+    return 0;
+
+  int removed = 0;
+  int class;
+  _Bool same;
+  DecisionTreeNode* left = node->isCategorical ? node->info.category.left : node->info.decision.left;
+  DecisionTreeNode* right = node->isCategorical ? node->info.category.right : node->info.decision.right;
+  removed += collapseTree(left);
+  removed += collapseTree(right);
+
+  class = left->info.class;
+  same = left->isLeaf && right->isLeaf && right->info.class == class;
+
+  if (!same)
+    return removed;
+
+  // free the children and keep the node as the leaf
+  removed += countNodes(node) - 1;
+  freeTree(left);
+  freeTree(right);
+  if (node->isCategorical)
+    free(node->info.category.inLeft);
+  node->isLeaf = 1;
+  node->isCategorical = 0;
+  node->info.class = class;
+  return removed;
+}
+
+// Collapses the tree's redundant splits and returns a flat layout of it in which every decision
+// node's more frequent child (on the sample rows) comes right after it
+// sample holds numRows rows of numFeatures values (row-major); without rows, the layout is left first.
+// The tree is changed in place but classifies every row the same. report (if not NULL) receives the
+// node counts, and the average path length and share of steps to the next node on the sample,
+// before (left first, not collapsed) and after
+FlatTree* optimizeTree(DecisionTree* tree, double* sample, int numRows, int numFeatures, OptimizeReport* report) {
+  assert(tree != NULL);
+  assert(numRows == 0 || sample != NULL);
+  long numSteps, numNext;
+
+  // before
+  FlatTree* before = flattenTree(tree->root);
+  profileFlat(before, sample, numRows, numFeatures, NULL, &numSteps, &numNext);
+  if (report) {
+    report->numNodesBefore = before->numNodes;
+    report->pathLengthBefore = numRows > 0 ? (double) numSteps / numRows : 0.0;
+    report->nextFractionBefore = numSteps > 0 ? (double) numNext / numSteps : 0.0;
+  }
+  freeFlatTree(before);
+
+  // collapse, count the visits of each node and lay them out again hot child first
+  collapseTree(tree->root);
+  FlatTree* plain = flattenTree(tree->root);
+  long* counts = (long*)calloc(plain->numNodes, sizeof(long));
+  profileFlat(plain, sample, numRows, numFeatures, counts, &numSteps, &numNext);
+
+  FlatTree* flat = allocFlatTree(plain->numNodes, plain->numLinks);
+  appendHot(plain, counts, flat, 0);
+  free(counts);
+  freeFlatTree(plain);
+
+  // after
+  profileFlat(flat, sample, numRows, numFeatures, NULL, &numSteps, &numNext);
+  if (report) {
+    report->numNodesAfter = flat->numNodes;
+    report->pathLengthAfter = numRows > 0 ? (double) numSteps / numRows : 0.0;
+    report->nextFractionAfter = numSteps > 0 ? (double) numNext / numSteps : 0.0;
+  }
+
+  return flat;
+}
@@ -0,0 +1,48 @@
+#ifndef OPTIMIZE_H_
+#define OPTIMIZE_H_
+
+#include "decision_tree.h"
+
+// Flat Tree
+typedef enum FlatKind {
+  FLAT_LEAF,
+  FLAT_HOT_LEFT,  // Decision node whose next node is its child for values <= the split
+  FLAT_HOT_RIGHT, // Decision node whose next node is its child for values > the split (the comparison is flipped)
+  FLAT_CATEGORY   // Categorical node with a jump table
+} FlatKind;
+
+typedef struct FlatNode { // A node of a tree laid out in one array
+  FlatKind kind;
+  int feature;     // The feature to split on
+  int value;       // Leaf: the class. Decision: index of the child that isn't next. Categorical: offset of its jump table in links
+  int numCodes;    // Categorical: size of the jump table (the entry after it is the child for other codes)
+  double split;    // Decision: the value to split at. Categorical: code of the first child
+} FlatNode;
+
+typedef struct FlatTree {
+  FlatNode* nodes; // nodes[0] is the root
+  int numNodes;
+  int* links;      // Jump tables of the categorical nodes
+  int numLinks;
+} FlatTree;
+
+FlatTree* flattenTree(DecisionTreeNode* root);
+int classifyFlat(FlatTree* flat, double* featureValues);
+void freeFlatTree(FlatTree* flat);
+
+
+
+// Optimizer
+typedef struct OptimizeReport {
+  int numNodesBefore;
+  int numNodesAfter;
+  double pathLengthBefore; // Average number of decision nodes a sample row passes (0 without a sample)
+  double pathLengthAfter;
+  double nextFractionBefore; // Fraction of those steps that go to the next node in the array
+  double nextFractionAfter;
+} OptimizeReport;
+
+int collapseTree(DecisionTreeNode* node);
+FlatTree* optimizeTree(DecisionTree* tree, double* sample, int numRows, int numFeatures, OptimizeReport* report);
+
+#endif
@@ -0,0 +1,1112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include "presort.h"
+#include "decision_tree.h"
+#include "input.h"
+
+// Options
+
+// Sets the options to grow the tree until every leaf is pure or noisy, like makeTree does
+void defaultTrainOptions(TrainOptions* options) {
+  assert(options != NULL);
+  options->maxDepth = 0;
+  options->minSplit = 0;
+  options->maxLeaves = 0;
+  options->memoryBudget = 0;
+  options->timeLimit = 0;
+}
+
+
+
+// Sorted Features
+
+// An instance's value for a feature, used to sort the instances on that feature
+typedef struct ValueIndex {
+  double value;
+  int index;
+} ValueIndex;
+
+// qsort comparator: ascending by value, then by instance index
+static int compareValueIndex(const void* a, const void* b) {
+  const ValueIndex* x = (const ValueIndex*) a;
+  const ValueIndex* y = (const ValueIndex*) b;
+  if (x->value < y->value) return -1;
+  if (x->value > y->value) return 1;
+  return x->index - y->index;
+}
+
+// Copies the instances into columns and sorts the instance indices on every feature
+// The result only depends on the input data, so it can be shared between builds (and threads).
+// Returns NULL if an allocation fails
+SortedFeatures* sortFeatures(Names* names) {
+  assert(names != NULL);
+  int numFeatures = names->numFeatures;
+  int numInstances = names->numInstances;
+
+  SortedFeatures* sorted = (SortedFeatures*)malloc(sizeof(SortedFeatures));
+  if (!sorted)
+    return NULL;
+  sorted->numFeatures = numFeatures;
+  sorted->numInstances = numInstances;
+  sorted->numClasses = names->numClasses;
+  sorted->classes = (int*)malloc(sizeof(int) * numInstances);
+  sorted->weights = (int*)malloc(sizeof(int) * numInstances);
+  sorted->classWeights = NULL;
+  sorted->columns = (double**)calloc(numFeatures, sizeof(double*));
+  sorted->order = (int**)calloc(numFeatures, sizeof(int*));
+  ValueIndex* pairs = (ValueIndex*)malloc(sizeof(ValueIndex) * numInstances);
+  _Bool failed = !sorted->classes || !sorted->weights || !sorted->columns || !sorted->order || !pairs;
+
+  for (int i = 0; i < numInstances && !failed; i++) {
+    sorted->classes[i] = names->instances[i]->class;
+    sorted->weights[i] = names->instances[i]->weight;
+    if (names->instances[i]->classWeights && !sorted->classWeights) {
+      sorted->classWeights = (int*)calloc((long) numInstances * names->numClasses, sizeof(int));
+      failed = !sorted->classWeights;
+    }
+  }
+
+  // per-class weights of deduplicated instances
+  if (sorted->classWeights)
+    for (int i = 0; i < numInstances; i++)
+      addClassWeights(names->instances[i], sorted->classWeights + (long) i * names->numClasses, names->numClasses);
+
+  // for each feature
+  for (int f = 0; f < numFeatures && !failed; f++) {
+    sorted->columns[f] = (double*)malloc(sizeof(double) * numInstances);
+    sorted->order[f] = (int*)malloc(sizeof(int) * numInstances);
+    if (!sorted->columns[f] || !sorted->order[f]) {
+      failed = 1;
+      break;
+    }
+
+    for (int i = 0; i < numInstances; i++) {
+      sorted->columns[f][i] = names->instances[i]->featureValues[f];
+      pairs[i].value = sorted->columns[f][i];
+      pairs[i].index = i;
+    }
+
+    qsort(pairs, numInstances, sizeof(ValueIndex), compareValueIndex);
+
+    for (int i = 0; i < numInstances; i++)
+      sorted->order[f][i] = pairs[i].index;
+  }
+
+  free(pairs);
+  if (failed) {
+    freeSortedFeatures(sorted);
+    return NULL;
+  }
+  return sorted;
+}
+
+// Frees the columns, the sort orders and the structure itself (which may be partly allocated)
+void freeSortedFeatures(SortedFeatures* sorted) {
+  for (int f = 0; f < sorted->numFeatures; f++) {
+    if (sorted->columns)
+      free(sorted->columns[f]);
+    if (sorted->order)
+      free(sorted->order[f]);
+  }
+  free(sorted->columns);
+  free(sorted->order);
+  free(sorted->classes);
+  free(sorted->weights);
+  free(sorted->classWeights);
+  free(sorted);
+}
+
+
+
+// Tree
+
+#define MAX_CATEGORIES 4096 // Widest code range a node splits by subset; wider categorical features split like ordered ones
+
+// Working state of one build
+// Every feature keeps its own copy of the rows being trained on, sorted by that feature.
+// The rows of a node occupy the same range [lo, hi) in every copy, so splitting a node is a
+// stable partition of that range and the sort order never has to be recomputed.
+typedef struct Builder {
+  SortedFeatures* sorted;
+  TrainOptions* options;
+  _Bool* categorical; // Feature types (NULL if all features are ordered)
+  int numClasses;
+
+  int** segments;  // segments[f] holds the rows sorted by feature f, grouped by node
+  int* scratch;    // Partition buffer, one slot per row
+  int* childOf;    // Child of the current split each row goes to, indexed by instance index
+
+  int* classCount; // Class counts of the current node
+  int* leftCount;  // Class counts left of the candidate split
+  int* rightCount; // Class counts right of the candidate split
+
+  // categorical features (NULL without any): the codes of the current node and their class counts
+  int* codeCounts;       // codeCounts[k * numCounts + c] counts class c (of each target in turn) among rows with code k
+  int* codeSize;         // codeSize[k] is the number of instances with code k
+  int* codeValue;        // codeValue[k] is code k, in increasing order
+  ValueIndex* codeOrder; // The codes sorted by the share of one class
+  unsigned char* subset; // Best subset of every target searched at once, then a candidate, MAX_CATEGORIES entries each
+} Builder;
+
+// The split chosen for a node
+typedef struct Split {
+  int feature;
+  double split;          // Ordered features: the value to split at
+  _Bool categorical;     // Categorical features: the codes in inLeft go left, the others right
+  int minCode;           // Categorical: code of inLeft[0]
+  int numCodes;          // Categorical: size of inLeft, from the node's smallest to largest code
+  unsigned char* inLeft; // Categorical: owned by the split until a node takes it (NULL otherwise)
+} Split;
+
+// Adds the classes of a row to the class counts and returns the number of instances the row stands for
+static int addRow(SortedFeatures* sorted, int* classCount, int row) {
+  if (sorted->classWeights) {
+    int* classWeights = sorted->classWeights + (long) row * sorted->numClasses;
+    for (int i = 0; i < sorted->numClasses; i++)
+      classCount[i] += classWeights[i];
+  } else {
+    classCount[sorted->classes[row]]++;
+  }
+  return sorted->weights[row];
+}
+
+// Returns the entropy of n instances with the given class counts
+static double classEntropy(int* classCount, int n, int numClasses) {
+  double info = 0.0;
+  for (int i = 0; i < numClasses; i++) {
+    double d = ((double) classCount[i]) / ((double) n);
+
+    if (d != 0)
+      info += -d * log2(d);
+  }
+  return info;
+}
+
+// Returns the expected entropy of a split given the class counts on each side
+// Performs the same arithmetic, in the same order, as info and calcEntropy in decision_tree.c
+// so that both builders pick the same splits
+static double splitEntropy(int* leftCount, int numLeft, int* rightCount, int numRight, int numClasses) {
+  int numInstances = numLeft + numRight;
+  double infoLeft = 0.0;
+  double infoRight = 0.0;
+
+  for (int i = 0; i < numClasses; i++) {
+    if (numLeft != 0) {
+      double dLeft = ((double) leftCount[i]) / ((double) numLeft);
+
+      if (dLeft != 0)
+	infoLeft += -dLeft * log2(dLeft);
+    }
+
+    if (numRight != 0) {
+      double dRight = ((double) rightCount[i]) / ((double) numRight);
+
+      if (dRight != 0)
+	infoRight += -dRight * log2(dRight);
+    }
+  }
+
+  double entropy = 0;
+  entropy += (((double) numLeft) / numInstances) * infoLeft;
+  entropy += (((double) numRight) / numInstances) * infoRight;
+  return entropy;
+}
+
+// Returns a new leaf node with the specified class
+static DecisionTreeNode* makeLeaf(int class) {
+  DecisionTreeNode* node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+  node->isLeaf = 1;
+  node->isCategorical = 0;
+  node->info.class = class;
+  return node;
+}
+
+// Gathers the codes of a categorical feature in the rows [lo, hi) into codeValue, with the number of
+// instances of each in codeSize, and returns how many there are. Class counts go to codeCounts with
+// numCounts counts per code: the class counts of the rows if classes is NULL, else those of each of
+// the numGroup targets in classes. The segment is sorted by the feature, so each code is a run of rows.
+static int countCodes(Builder* b, int lo, int hi, int feature, int** classes, int numGroup) {
+  int numClasses = b->numClasses;
+  int numCounts = classes ? numGroup * numClasses : numClasses;
+  double* column = b->sorted->columns[feature];
+  int* segment = b->segments[feature];
+  int numCodes = 0;
+
+  for (int p = lo; p < hi; p++) {
+    int row = segment[p];
+    if (p == lo || column[row] != column[segment[p - 1]]) {
+      b->codeValue[numCodes] = (int) column[row];
+      b->codeSize[numCodes] = 0;
+      memset(b->codeCounts + (long) numCodes * numCounts, 0, sizeof(int) * numCounts);
+      numCodes++;
+    }
+
+    int* counts = b->codeCounts + (long) (numCodes - 1) * numCounts;
+    if (classes) {
+      for (int g = 0; g < numGroup; g++)
+	counts[g * numClasses + classes[g][row]]++;
+      b->codeSize[numCodes - 1]++;
+    } else {
+      b->codeSize[numCodes - 1] += addRow(b->sorted, counts, row);
+    }
+  }
+  return numCodes;
+}
+
+// Sorts the codes by the share of the class among their instances, ties in code order
+// counts points at the class counts of the first code, and the codes' counts are numCounts apart
+static void orderCodes(Builder* b, int* counts, int numCounts, int numCodes, int class) {
+  for (int k = 0; k < numCodes; k++) {
+    b->codeOrder[k].value = (double) counts[(long) k * numCounts + class] / b->codeSize[k];
+    b->codeOrder[k].index = k;
+  }
+  qsort(b->codeOrder, numCodes, sizeof(ValueIndex), compareValueIndex);
+}
+
+// Finds the subset of the codes counted by countCodes whose split of the rows (numInstances instances
+// with the class counts classCount) has the lowest expected entropy, and returns that entropy
+// The codes are sorted by the share of one class, and every prefix of that order is a candidate, for
+// each class in turn (one is enough for two classes): with two classes the best prefix is the best
+// subset, and with more it is a good one, found in O(K log K) per class for K codes. counts and
+// numCounts are as in orderCodes. inLeft receives the side of every code from codeValue[0] on: 1 for
+// the smaller side, so the codes that weren't seen go with the larger one, which is 0 like the gaps.
+static double subsetEntropy(Builder* b, int* counts, int numCounts, int numCodes, int* classCount, int numInstances,
+			    unsigned char* inLeft) {
+  int numClasses = b->numClasses;
+  double minEntropy = -1;
+  int bestClass = 0;
+  int bestPrefix = 0;
+
+  for (int c = 0; c < (numClasses == 2 ? 1 : numClasses); c++) {
+    orderCodes(b, counts, numCounts, numCodes, c);
+    for (int i = 0; i < numClasses; i++)
+      b->leftCount[i] = 0;
+    int numLeft = 0;
+
+    // move the codes to the left one at a time, evaluating every split that leaves both sides a code
+    for (int j = 0; j + 1 < numCodes; j++) {
+      int k = b->codeOrder[j].index;
+      for (int i = 0; i < numClasses; i++)
+	b->leftCount[i] += counts[(long) k * numCounts + i];
+      numLeft += b->codeSize[k];
+
+      for (int i = 0; i < numClasses; i++)
+	b->rightCount[i] = classCount[i] - b->leftCount[i];
+      double entropy = splitEntropy(b->leftCount, numLeft, b->rightCount, numInstances - numLeft, numClasses);
+      if (entropy < minEntropy || minEntropy == -1) {
+	minEntropy = entropy;
+	bestClass = c;
+	bestPrefix = j + 1;
+      }
+    }
+  }
+
+  // mark the smaller side of the best split
+  orderCodes(b, counts, numCounts, numCodes, bestClass);
+  int numPrefix = 0;
+  for (int j = 0; j < bestPrefix; j++)
+    numPrefix += b->codeSize[b->codeOrder[j].index];
+  _Bool prefixLeft = 2 * numPrefix <= numInstances;
+  memset(inLeft, 0, b->codeValue[numCodes - 1] - b->codeValue[0] + 1);
+  for (int j = 0; j < numCodes; j++)
+    if ((j < bestPrefix) == prefixLeft)
+      inLeft[b->codeValue[b->codeOrder[j].index] - b->codeValue[0]] = 1;
+  return minEntropy;
+}
+
+// Hands the subset of a categorical split over to it in a buffer of its own
+static void keepSubset(Split* split, unsigned char* subset) {
+  split->inLeft = (unsigned char*)malloc(split->numCodes);
+  memcpy(split->inLeft, subset, split->numCodes);
+}
+
+// Finds the split that minimizes the entropy of the rows in [lo, hi)
+// Ordered features are split at a value, categorical ones into a subset of the codes and the rest.
+// Ties are broken like findBestFeatureAndSplit: the lower feature wins, then the value that
+// appears first in the rows. Splits that would leave one side empty are never chosen.
+// numInstances is the number of instances the rows stand for. entropyOut receives the expected entropy
+// of the best split. Returns 0 if no split separates the rows
+static _Bool findBestSplit(Builder* b, int lo, int hi, int numInstances, Split* best, double* entropyOut) {
+  int numClasses = b->numClasses;
+  double minEntropy = -1;
+  int bestFirst = 0; // Lowest row index holding the best split value
+  best->feature = -1;
+  best->split = 0.0;
+  best->categorical = 0;
+  best->minCode = 0;
+  best->numCodes = 0;
+  best->inLeft = NULL;
+
+  // for each feature
+  for (int f = 0; f < b->sorted->numFeatures; f++) {
+    double* column = b->sorted->columns[f];
+    int* segment = b->segments[f];
+    int groupStart = lo;
+
+    // categorical: subset split, if the node's codes fit in a jump table
+    if (b->categorical && b->categorical[f]) {
+      double minCode = column[segment[lo]];
+      double maxCode = column[segment[hi - 1]];
+      if (maxCode - minCode < MAX_CATEGORIES) {
+	int numCodes = countCodes(b, lo, hi, f, NULL, 1);
+	if (numCodes < 2)
+	  continue;
+	double entropy = subsetEntropy(b, b->codeCounts, numClasses, numCodes, b->classCount, numInstances, b->subset + MAX_CATEGORIES);
+	if (entropy < minEntropy || minEntropy == -1) {
+	  minEntropy = entropy;
+	  best->feature = f;
+	  best->categorical = 1;
+	  best->minCode = (int) minCode;
+	  best->numCodes = (int) maxCode - (int) minCode + 1;
+	  memcpy(b->subset, b->subset + MAX_CATEGORIES, best->numCodes);
+	}
+	continue;
+      }
+    }
+
+    for (int i = 0; i < numClasses; i++)
+      b->leftCount[i] = 0;
+    int numLeft = 0;
+
+    // sweep the rows in increasing order of the feature,
+    // evaluating a split after the last row of each run of equal values
+    for (int p = lo; p < hi; p++) {
+      int row = segment[p];
+      numLeft += addRow(b->sorted, b->leftCount, row);
+
+      if (p + 1 < hi && column[segment[p + 1]] == column[row])
+	continue;
+
+      int numRight = numInstances - numLeft;
+      int first = segment[groupStart];
+      groupStart = p + 1;
+      if (numRight == 0)
+	continue;
+
+      for (int i = 0; i < numClasses; i++)
+	b->rightCount[i] = b->classCount[i] - b->leftCount[i];
+
+      double entropy = splitEntropy(b->leftCount, numLeft, b->rightCount, numRight, numClasses);
+
+      if (entropy < minEntropy || minEntropy == -1 || (entropy == minEntropy && f == best->feature && first < bestFirst)) {
+	minEntropy = entropy;
+	best->feature = f;
+	best->categorical = 0;
+	best->split = column[row];
+	bestFirst = first;
+      }
+    }
+  }
+
+  if (best->categorical)
+    keepSubset(best, b->subset);
+  *entropyOut = minEntropy;
+  return best->feature != -1;
+}
+
+// Stably partitions the range [lo, hi) of every segment by the child each row goes to
+// Fills in start[0] = lo, start[1], the first position of the right child, and start[2] = hi
+static void partition(Builder* b, int lo, int hi, Split* split, int* start) {
+  double* column = b->sorted->columns[split->feature];
+  int next[2];
+
+  for (int k = 0; k <= 2; k++)
+    start[k] = 0;
+
+  // assign each row a child and count the rows of each child
+  for (int p = lo; p < hi; p++) {
+    int row = b->segments[split->feature][p];
+    if (split->categorical)
+      b->childOf[row] = split->inLeft[(int) column[row] - split->minCode] ? 0 : 1;
+    else
+      b->childOf[row] = column[row] <= split->split ? 0 : 1;
+    start[b->childOf[row] + 1]++;
+  }
+
+  start[0] = lo;
+  for (int k = 0; k < 2; k++)
+    start[k + 1] += start[k];
+
+  // scatter every segment by child, keeping the sorted order within each child
+  for (int f = 0; f < b->sorted->numFeatures; f++) {
+    int* segment = b->segments[f];
+    for (int k = 0; k < 2; k++)
+      next[k] = start[k] - lo;
+
+    for (int p = lo; p < hi; p++) {
+      int row = segment[p];
+      b->scratch[next[b->childOf[row]]] = row;
+      next[b->childOf[row]]++;
+    }
+    memcpy(segment + lo, b->scratch, sizeof(int) * (hi - lo));
+  }
+}
+
+// Turns the node into a decision node with the split, which hands its subset (if any) over to the node
+static void setSplit(DecisionTreeNode* node, Split* split) {
+  node->isLeaf = 0;
+  node->isCategorical = split->categorical;
+  if (split->categorical) {
+    node->info.category.feature = split->feature;
+    node->info.category.minCode = split->minCode;
+    node->info.category.numCodes = split->numCodes;
+    node->info.category.inLeft = split->inLeft;
+    split->inLeft = NULL;
+  } else {
+    node->info.decision.feature = split->feature;
+    node->info.decision.split = split->split;
+  }
+}
+
+// Sets the children of a decision node made by setSplit
+static void setChildren(DecisionTreeNode* node, DecisionTreeNode* left, DecisionTreeNode* right) {
+  if (node->isCategorical) {
+    node->info.category.left = left;
+    node->info.category.right = right;
+  } else {
+    node->info.decision.left = left;
+    node->info.decision.right = right;
+  }
+}
+
+// Counts the classes of the rows in [lo, hi) into classCount and returns the majority class (the
+// lowest class wins ties, like majorityClass). numInstances receives the number of instances the rows
+// stand for, and splittable whether the node may be split: its rows are neither all of one class nor
+// all alike, and the depth and size limits allow it
+static int examineNode(Builder* b, int lo, int hi, int depth, int* numInstances, _Bool* splittable) {
+  assert(hi > lo);
+  int numClasses = b->numClasses;
+  int numFeatures = b->sorted->numFeatures;
+
+  // count classes
+  *numInstances = 0;
+  for (int i = 0; i < numClasses; i++)
+    b->classCount[i] = 0;
+  for (int p = lo; p < hi; p++)
+    *numInstances += addRow(b->sorted, b->classCount, b->segments[0][p]);
+
+  // pick the majority
+  int majClass = 0;
+  int numPresent = 0;
+  for (int i = 0; i < numClasses; i++) {
+    if (b->classCount[i] > b->classCount[majClass])
+      majClass = i;
+    if (b->classCount[i] > 0)
+      numPresent++;
+  }
+
+  // same class
+  *splittable = 0;
+  if (numPresent == 1)
+    return majClass;
+
+  // noisy data: every feature is constant over the rows
+  _Bool noisy = 1;
+  for (int f = 0; f < numFeatures && noisy; f++)
+    if (b->sorted->columns[f][b->segments[f][lo]] != b->sorted->columns[f][b->segments[f][hi - 1]])
+      noisy = 0;
+  if (noisy)
+    return majClass;
+
+  // stopping options
+  if ((b->options->maxDepth > 0 && depth >= b->options->maxDepth) || *numInstances < b->options->minSplit)
+    return majClass;
+
+  *splittable = 1;
+  return majClass;
+}
+
+// Recursive function that creates a decision tree on the rows in [lo, hi)
+// Mirrors learn in decision_tree.c, but reads the presorted segments instead of rescanning the instances
+static DecisionTreeNode* learnSorted(Builder* b, int lo, int hi, int depth) {
+  int numInstances;
+  _Bool splittable;
+  int majClass = examineNode(b, lo, hi, depth, &numInstances, &splittable);
+
+  Split split;
+  double entropy;
+  if (!splittable || !findBestSplit(b, lo, hi, numInstances, &split, &entropy))
+    return makeLeaf(majClass);
+
+  int start[3];
+  partition(b, lo, hi, &split, start);
+
+  DecisionTreeNode* node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+  setSplit(node, &split);
+
+  // recurse
+  DecisionTreeNode* left = learnSorted(b, start[0], start[1], depth + 1);
+  DecisionTreeNode* right = learnSorted(b, start[1], start[2], depth + 1);
+  setChildren(node, left, right);
+  return node;
+}
+
+
+
+// Best-First Growth
+
+// A leaf of a best-first build that has a split to be made
+// Leaves own disjoint ranges of the segments, so they can be split in any order
+typedef struct OpenLeaf {
+  DecisionTreeNode* node; // The leaf in the tree, turned into a decision node in place when it's split
+  int lo;
+  int hi;
+  int depth;
+  int majClass;
+  double gain;   // Entropy the split removes, times the number of instances the rows stand for
+  long order;    // Order in which the leaves were opened, which breaks ties in gain
+  Split split;
+} OpenLeaf;
+
+// Binary max-heap of the open leaves, keyed by gain
+typedef struct LeafQueue {
+  OpenLeaf* leaves;
+  int numLeaves;
+  int capacity;
+  long numOpened;
+} LeafQueue;
+
+// Returns 1 if leaf a is split before leaf b
+static inline _Bool comesFirst(OpenLeaf* a, OpenLeaf* b) {
+  return a->gain > b->gain || (a->gain == b->gain && a->order < b->order);
+}
+
+// Adds a leaf to the queue
+static void pushLeaf(LeafQueue* queue, OpenLeaf* leaf) {
+  if (queue->numLeaves == queue->capacity) {
+    queue->capacity *= 2;
+    queue->leaves = (OpenLeaf*)realloc(queue->leaves, sizeof(OpenLeaf) * queue->capacity);
+  }
+
+  // sift up
+  int i = queue->numLeaves;
+  queue->numLeaves++;
+  while (i > 0 && comesFirst(leaf, &queue->leaves[(i - 1) / 2])) {
+    queue->leaves[i] = queue->leaves[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  queue->leaves[i] = *leaf;
+}
+
+// Removes the leaf with the largest gain from the queue and copies it into leaf
+static void popLeaf(LeafQueue* queue, OpenLeaf* leaf) {
+  assert(queue->numLeaves > 0);
+  *leaf = queue->leaves[0];
+  queue->numLeaves--;
+  OpenLeaf last = queue->leaves[queue->numLeaves];
+
+  // sift the last leaf down from the root
+  int i = 0;
+  while (1) {
+    int child = 2 * i + 1;
+    if (child >= queue->numLeaves)
+      break;
+    if (child + 1 < queue->numLeaves && comesFirst(&queue->leaves[child + 1], &queue->leaves[child]))
+      child++;
+    if (!comesFirst(&queue->leaves[child], &last))
+      break;
+    queue->leaves[i] = queue->leaves[child];
+    i = child;
+  }
+  queue->leaves[i] = last;
+}
+
+// Makes the node a leaf of the majority class of the rows in [lo, hi) and queues it with its best split,
+// unless it can't be split
+static void openLeaf(Builder* b, LeafQueue* queue, DecisionTreeNode* node, int lo, int hi, int depth) {
+  int numInstances;
+  _Bool splittable;
+  OpenLeaf leaf;
+  double entropy;
+
+  leaf.majClass = examineNode(b, lo, hi, depth, &numInstances, &splittable);
+  node->isLeaf = 1;
+  node->isCategorical = 0;
+  node->info.class = leaf.majClass;
+  if (!splittable || !findBestSplit(b, lo, hi, numInstances, &leaf.split, &entropy))
+    return;
+
+  leaf.node = node;
+  leaf.lo = lo;
+  leaf.hi = hi;
+  leaf.depth = depth;
+  leaf.gain = numInstances * (classEntropy(b->classCount, numInstances, b->numClasses) - entropy);
+  leaf.order = queue->numOpened;
+  queue->numOpened++;
+  pushLeaf(queue, &leaf);
+}
+
+// Returns the current time of a monotonic clock in seconds
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Creates a decision tree on the rows in [0, numRows) by always splitting the leaf whose split removes
+// the most entropy next. A split that would take the tree past the leaf or memory budget is skipped, and
+// once the time limit is up the leaves left are kept as they are, so the tree is valid whenever it stops.
+// Splits are chosen like learnSorted's, so with budgets large enough the tree is the same.
+static DecisionTreeNode* learnBestFirst(Builder* b, int numRows) {
+  TrainOptions* options = b->options;
+  double deadline = now() + options->timeLimit;
+  LeafQueue queue;
+  queue.capacity = 64;
+  queue.leaves = (OpenLeaf*)malloc(sizeof(OpenLeaf) * queue.capacity);
+  queue.numLeaves = 0;
+  queue.numOpened = 0;
+
+  DecisionTreeNode* root = makeLeaf(0);
+  int numLeaves = 1;
+  long memoryUsed = sizeof(DecisionTreeNode);
+  openLeaf(b, &queue, root, 0, numRows, 0);
+
+  while (queue.numLeaves > 0 && (options->timeLimit <= 0 || now() < deadline)
+	 && (options->maxLeaves <= 0 || numLeaves < options->maxLeaves)) {
+    OpenLeaf leaf;
+    popLeaf(&queue, &leaf);
+
+    // what the split adds: two leaves, and a categorical node's jump table
+    long bytes = 2 * sizeof(DecisionTreeNode);
+    if (leaf.split.categorical)
+      bytes += leaf.split.numCodes;
+    if ((options->maxLeaves > 0 && numLeaves + 1 > options->maxLeaves)
+	|| (options->memoryBudget > 0 && memoryUsed + bytes > options->memoryBudget)) {
+      free(leaf.split.inLeft);
+      continue;
+    }
+    numLeaves++;
+    memoryUsed += bytes;
+
+    int start[3];
+    partition(b, leaf.lo, leaf.hi, &leaf.split, start);
+
+    DecisionTreeNode* left = makeLeaf(0);
+    DecisionTreeNode* right = makeLeaf(0);
+    setSplit(leaf.node, &leaf.split);
+    setChildren(leaf.node, left, right);
+    openLeaf(b, &queue, left, start[0], start[1], leaf.depth + 1);
+    openLeaf(b, &queue, right, start[1], start[2], leaf.depth + 1);
+  }
+
+  // leaves still queued are already leaves of their majority class
+  for (int i = 0; i < queue.numLeaves; i++)
+    free(queue.leaves[i].split.inLeft);
+  free(queue.leaves);
+  return root;
+}
+
+
+
+// Frees the segments and buffers of a build (which may be partly allocated)
+static void freeBuilder(Builder* b) {
+  for (int f = 0; b->segments && f < b->sorted->numFeatures; f++)
+    free(b->segments[f]);
+  free(b->segments);
+  free(b->scratch);
+  free(b->childOf);
+  free(b->classCount);
+  free(b->leftCount);
+  free(b->rightCount);
+  free(b->codeCounts);
+  free(b->codeSize);
+  free(b->codeValue);
+  free(b->codeOrder);
+  free(b->subset);
+}
+
+// Sets up the segments and buffers of a build on the rows of a view (NULL for all instances)
+// numCounts is the number of class counts leftCount needs room for (numClasses per target searched at once)
+// Returns 0, having freed what it allocated, if an allocation fails
+static _Bool initBuilder(Builder* b, Names* names, SortedFeatures* sorted, int* rows, int numRows, TrainOptions* options, int numCounts) {
+  int numFeatures = names->numFeatures;
+  int numInstances = names->numInstances;
+
+  b->sorted = sorted;
+  b->options = options;
+  b->categorical = names->categorical;
+  b->numClasses = names->numClasses;
+  b->segments = (int**)calloc(numFeatures, sizeof(int*));
+  b->scratch = (int*)malloc(sizeof(int) * numRows);
+  b->childOf = (int*)malloc(sizeof(int) * numInstances);
+  b->classCount = (int*)malloc(sizeof(int) * b->numClasses);
+  b->leftCount = (int*)malloc(sizeof(int) * numCounts);
+  b->rightCount = (int*)malloc(sizeof(int) * b->numClasses);
+  _Bool failed = !b->segments || !b->scratch || !b->childOf || !b->classCount || !b->leftCount || !b->rightCount;
+
+  // the subset search, with room for the best subset of every target and a candidate
+  b->codeCounts = NULL;
+  b->codeSize = NULL;
+  b->codeValue = NULL;
+  b->codeOrder = NULL;
+  b->subset = NULL;
+  if (b->categorical && !failed) {
+    b->codeCounts = (int*)malloc(sizeof(int) * MAX_CATEGORIES * numCounts);
+    b->codeSize = (int*)malloc(sizeof(int) * MAX_CATEGORIES);
+    b->codeValue = (int*)malloc(sizeof(int) * MAX_CATEGORIES);
+    b->codeOrder = (ValueIndex*)malloc(sizeof(ValueIndex) * MAX_CATEGORIES);
+    b->subset = (unsigned char*)malloc((long) MAX_CATEGORIES * (numCounts / b->numClasses + 1));
+    failed = !b->codeCounts || !b->codeSize || !b->codeValue || !b->codeOrder || !b->subset;
+  }
+  for (int f = 0; f < numFeatures && !failed; f++) {
+    b->segments[f] = (int*)malloc(sizeof(int) * numRows);
+    failed = !b->segments[f];
+  }
+  if (failed) {
+    freeBuilder(b);
+    return 0;
+  }
+
+  // Mark the rows in the view, then filter each global sort order down to them
+  int* inView = b->childOf;
+  for (int i = 0; i < numInstances; i++)
+    inView[i] = rows == NULL;
+  if (rows != NULL)
+    for (int i = 0; i < numRows; i++)
+      inView[rows[i]] = 1;
+
+  for (int f = 0; f < numFeatures; f++) {
+    int index = 0;
+    for (int i = 0; i < numInstances; i++)
+      if (inView[sorted->order[f][i]]) {
+	b->segments[f][index] = sorted->order[f][i];
+	index++;
+      }
+    assert(index == numRows);
+  }
+  return 1;
+}
+
+// Constructs a tree on a subset of the instances and returns a pointer to it
+// rows lists the instance indices to train on in increasing order (NULL for all instances).
+// The rows are a view into names, so nothing is copied; sorted must come from sortFeatures(names)
+// and is only read, so several builds may share it concurrently.
+// Features marked categorical in names get subset splits; with only ordered features and
+// default options the tree is the same as the one makeTree builds. If any budget of the options is
+// set, the tree grows best-first instead (see learnBestFirst).
+// Returns NULL if the build's working buffers can't be allocated
+DecisionTree* makeTreeSorted(Names* names, SortedFeatures* sorted, int* rows, int numRows, TrainOptions* options) {
+  assert(names != NULL);
+  assert(sorted != NULL);
+  assert(options != NULL);
+  if (rows == NULL)
+    numRows = names->numInstances;
+  assert(numRows > 0);
+
+  Builder b;
+  DecisionTree* tree = (DecisionTree*)malloc(sizeof(DecisionTree));
+  if (!tree || !initBuilder(&b, names, sorted, rows, numRows, options, names->numClasses)) {
+    free(tree);
+    return NULL;
+  }
+  if (options->maxLeaves > 0 || options->memoryBudget > 0 || options->timeLimit > 0)
+    tree->root = learnBestFirst(&b, numRows);
+  else
+    tree->root = learnSorted(&b, 0, numRows, 0);
+
+  freeBuilder(&b);
+  return tree;
+}
+
+
+
+// Multiple Targets
+
+// Returns 1 if two splits send every row to the same child
+static _Bool sameSplit(Split* a, Split* b) {
+  if (a->feature != b->feature || a->categorical != b->categorical)
+    return 0;
+  if (a->categorical)
+    return a->minCode == b->minCode && a->numCodes == b->numCodes && memcmp(a->inLeft, b->inLeft, a->numCodes) == 0;
+  return a->split == b->split;
+}
+
+// Finds the split that minimizes the entropy of the rows in [lo, hi) for every target of a group
+// One sweep over each feature's segment serves the whole group: the rows and the runs of equal
+// values are shared, only the class counts are kept per target. Ties are broken like findBestSplit,
+// so every target gets the split a build of its own would pick.
+// classes[g] holds the classes of the group's target g and classCount[g * numClasses + c] its class
+// counts in the node. best[g] receives its split (feature -1 if no split separates the rows)
+static void findBestSplits(Builder* b, int** classes, int numGroup, int lo, int hi, int* classCount, Split* best) {
+  int numClasses = b->numClasses;
+  int numInstances = hi - lo;
+  double minEntropy[numGroup];
+  int bestFirst[numGroup]; // Lowest row index holding the best split value
+  for (int g = 0; g < numGroup; g++) {
+    minEntropy[g] = -1;
+    bestFirst[g] = 0;
+    best[g].feature = -1;
+    best[g].split = 0.0;
+    best[g].categorical = 0;
+    best[g].minCode = 0;
+    best[g].numCodes = 0;
+    best[g].inLeft = NULL;
+  }
+
+  // for each feature
+  for (int f = 0; f < b->sorted->numFeatures; f++) {
+    double* column = b->sorted->columns[f];
+    int* segment = b->segments[f];
+    int groupStart = lo;
+    memset(b->leftCount, 0, sizeof(int) * numGroup * numClasses);
+
+    // categorical: subset split, if the node's codes fit in a jump table
+    if (b->categorical && b->categorical[f]) {
+      double minCode = column[segment[lo]];
+      double maxCode = column[segment[hi - 1]];
+      if (maxCode - minCode < MAX_CATEGORIES) {
+	int numCodes = countCodes(b, lo, hi, f, classes, numGroup);
+	if (numCodes < 2)
+	  continue;
+
+	unsigned char* candidate = b->subset + (long) numGroup * MAX_CATEGORIES;
+	for (int g = 0; g < numGroup; g++) {
+	  double e = subsetEntropy(b, b->codeCounts + g * numClasses, numGroup * numClasses, numCodes,
+				   classCount + g * numClasses, numInstances, candidate);
+	  if (e < minEntropy[g] || minEntropy[g] == -1) {
+	    minEntropy[g] = e;
+	    best[g].feature = f;
+	    best[g].categorical = 1;
+	    best[g].minCode = (int) minCode;
+	    best[g].numCodes = (int) maxCode - (int) minCode + 1;
+	    memcpy(b->subset + (long) g * MAX_CATEGORIES, candidate, best[g].numCodes);
+	  }
+	}
+	continue;
+      }
+    }
+
+    // sweep the rows in increasing order of the feature,
+    // evaluating every target's split after the last row of each run of equal values
+    int numLeft = 0;
+    for (int p = lo; p < hi; p++) {
+      int row = segment[p];
+      for (int g = 0; g < numGroup; g++)
+	b->leftCount[g * numClasses + classes[g][row]]++;
+      numLeft++;
+
+      if (p + 1 < hi && column[segment[p + 1]] == column[row])
+	continue;
+
+      int numRight = numInstances - numLeft;
+      int first = segment[groupStart];
+      groupStart = p + 1;
+      if (numRight == 0)
+	continue;
+
+      for (int g = 0; g < numGroup; g++) {
+	int* leftCount = b->leftCount + g * numClasses;
+	for (int i = 0; i < numClasses; i++)
+	  b->rightCount[i] = classCount[g * numClasses + i] - leftCount[i];
+
+	double e = splitEntropy(leftCount, numLeft, b->rightCount, numRight, numClasses);
+
+	if (e < minEntropy[g] || minEntropy[g] == -1 || (e == minEntropy[g] && f == best[g].feature && first < bestFirst[g])) {
+	  minEntropy[g] = e;
+	  best[g].feature = f;
+	  best[g].categorical = 0;
+	  best[g].split = column[row];
+	  bestFirst[g] = first;
+	}
+      }
+    }
+  }
+
+  for (int g = 0; g < numGroup; g++)
+    if (best[g].categorical)
+      keepSubset(&best[g], b->subset + (long) g * MAX_CATEGORIES);
+}
+
+// Recursive function that grows the trees of a group of targets on the rows in [lo, hi)
+// The targets share the segments, and every pass over them, for as long as they pick the same
+// splits. When they disagree they are regrouped by split, and each new group partitions the range
+// in turn from a saved copy of its sorted order.
+// classes[g] holds the classes of target g of the group; nodes[g] receives that target's node
+static void learnTargets(Builder* b, int** classes, int numGroup, int lo, int hi, int depth, DecisionTreeNode** nodes) {
+  assert(hi > lo);
+  int numClasses = b->numClasses;
+  int numFeatures = b->sorted->numFeatures;
+  int numInstances = hi - lo;
+
+  // count classes of every target in one pass
+  int* classCount = (int*)calloc(numGroup * numClasses, sizeof(int));
+  for (int p = lo; p < hi; p++) {
+    int row = b->segments[0][p];
+    for (int g = 0; g < numGroup; g++)
+      classCount[g * numClasses + classes[g][row]]++;
+  }
+
+  // noisy data: every feature is constant over the rows
+  _Bool noisy = 1;
+  for (int f = 0; f < numFeatures && noisy; f++)
+    if (b->sorted->columns[f][b->segments[f][lo]] != b->sorted->columns[f][b->segments[f][hi - 1]])
+      noisy = 0;
+
+  // stopping options
+  _Bool stop = noisy || (b->options->maxDepth > 0 && depth >= b->options->maxDepth) || numInstances < b->options->minSplit;
+
+  // pick each target's majority; pure targets and stopped nodes become leaves
+  int majClass[numGroup];
+  int numSplitting = 0;
+  int** splittingClasses = (int**)malloc(sizeof(int*) * numGroup);
+  int* splittingCount = (int*)malloc(sizeof(int) * numGroup * numClasses);
+  int* splittingIndex = (int*)malloc(sizeof(int) * numGroup); // Index in the group of each splitting target
+  for (int g = 0; g < numGroup; g++) {
+    int* count = classCount + g * numClasses;
+    int numPresent = 0;
+    majClass[g] = 0;
+    for (int i = 0; i < numClasses; i++) {
+      if (count[i] > count[majClass[g]])
+	majClass[g] = i;
+      if (count[i] > 0)
+	numPresent++;
+    }
+
+    if (numPresent == 1 || stop) {
+      nodes[g] = makeLeaf(majClass[g]);
+    } else {
+      splittingClasses[numSplitting] = classes[g];
+      memcpy(splittingCount + numSplitting * numClasses, count, sizeof(int) * numClasses);
+      splittingIndex[numSplitting] = g;
+      numSplitting++;
+    }
+  }
+  free(classCount);
+
+  Split* splits = (Split*)malloc(sizeof(Split) * (numSplitting > 0 ? numSplitting : 1));
+  if (numSplitting > 0)
+    findBestSplits(b, splittingClasses, numSplitting, lo, hi, splittingCount, splits);
+
+  // regroup the targets that found a split by the split they picked
+  int* groupOf = (int*)malloc(sizeof(int) * (numSplitting > 0 ? numSplitting : 1));
+  int* firstOfGroup = (int*)malloc(sizeof(int) * (numSplitting > 0 ? numSplitting : 1));
+  int numGroups = 0;
+  for (int j = 0; j < numSplitting; j++) {
+    groupOf[j] = -1;
+    if (splits[j].feature == -1) {
+      nodes[splittingIndex[j]] = makeLeaf(majClass[splittingIndex[j]]);
+      continue;
+    }
+    for (int k = 0; k < numGroups && groupOf[j] == -1; k++)
+      if (sameSplit(&splits[j], &splits[firstOfGroup[k]]))
+	groupOf[j] = k;
+    if (groupOf[j] == -1) {
+      groupOf[j] = numGroups;
+      firstOfGroup[numGroups] = j;
+      numGroups++;
+    }
+  }
+
+  // every group but the last partitions the range away from the sorted order the next one needs
+  int* saved = NULL;
+  if (numGroups > 1) {
+    saved = (int*)malloc(sizeof(int) * numFeatures * numInstances);
+    for (int f = 0; f < numFeatures; f++)
+      memcpy(saved + f * numInstances, b->segments[f] + lo, sizeof(int) * numInstances);
+  }
+
+  int** memberClasses = (int**)malloc(sizeof(int*) * (numSplitting > 0 ? numSplitting : 1));
+  DecisionTreeNode** memberNodes = (DecisionTreeNode**)malloc(sizeof(DecisionTreeNode*) * (numSplitting > 0 ? numSplitting : 1));
+  DecisionTreeNode** childNodes = (DecisionTreeNode**)malloc(sizeof(DecisionTreeNode*) * (numSplitting > 0 ? numSplitting : 1));
+
+  for (int k = 0; k < numGroups; k++) {
+    if (k > 0)
+      for (int f = 0; f < numFeatures; f++)
+	memcpy(b->segments[f] + lo, saved + f * numInstances, sizeof(int) * numInstances);
+
+    int start[3];
+    partition(b, lo, hi, &splits[firstOfGroup[k]], start);
+
+    // one node per member, all with the same split
+    int numMembers = 0;
+    for (int j = 0; j < numSplitting; j++) {
+      if (groupOf[j] != k)
+	continue;
+      DecisionTreeNode* node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+      setSplit(node, &splits[j]);
+      nodes[splittingIndex[j]] = node;
+      memberClasses[numMembers] = splittingClasses[j];
+      memberNodes[numMembers] = node;
+      numMembers++;
+    }
+
+    // recurse, once for the whole group per child
+    DecisionTreeNode** leftNodes = (DecisionTreeNode**)malloc(sizeof(DecisionTreeNode*) * numMembers);
+    learnTargets(b, memberClasses, numMembers, start[0], start[1], depth + 1, leftNodes);
+    learnTargets(b, memberClasses, numMembers, start[1], start[2], depth + 1, childNodes);
+    for (int m = 0; m < numMembers; m++)
+      setChildren(memberNodes[m], leftNodes[m], childNodes[m]);
+    free(leftNodes);
+  }
+
+  free(saved);
+  free(memberClasses);
+  free(memberNodes);
+  free(childNodes);
+  free(groupOf);
+  free(firstOfGroup);
+  free(splits);
+  free(splittingClasses);
+  free(splittingCount);
+  free(splittingIndex);
+}
+
+// Constructs one tree per target (label column) of names and returns an array of them
+// The trees are grown together over the shared presorted features: the class counts of every target
+// are gathered in one pass, and the targets that pick the same split keep sharing one partition of
+// the rows and one sweep per feature. Each tree is the same as the one makeTreeSorted would build
+// with that target as the class. Names with a single target give an array of one tree.
+// Budgets grow each tree best-first on its own, and every tree gets the whole budget.
+// Returns NULL if the build's working buffers can't be allocated
+DecisionTree** makeTreesSorted(Names* names, SortedFeatures* sorted, TrainOptions* options) {
+  assert(names != NULL);
+  assert(sorted != NULL);
+  assert(options != NULL);
+  assert(names->numInstances > 0);
+  assert(sorted->classWeights == NULL); // Weighted instances only count the classes of one target
+
+  int numTargets = names->targets ? names->numTargets : 1;
+  int** classes = names->targets ? names->targets : &sorted->classes;
+
+  // best-first trees pick their leaves by their own target's gains, so they can't be grown together
+  if (options->maxLeaves > 0 || options->memoryBudget > 0 || options->timeLimit > 0) {
+    DecisionTree** trees = (DecisionTree**)malloc(sizeof(DecisionTree*) * numTargets);
+    if (!trees)
+      return NULL;
+    for (int t = 0; t < numTargets; t++) {
+      SortedFeatures target = *sorted; // A view whose classes are those of target t
+      target.classes = classes[t];
+      trees[t] = makeTreeSorted(names, &target, NULL, 0, options);
+      if (!trees[t]) {
+	for (int u = 0; u < t; u++) {
+	  freeTree(trees[u]->root);
+	  free(trees[u]);
+	}
+	free(trees);
+	return NULL;
+      }
+    }
+    return trees;
+  }
+
+  Builder b;
+  if (!initBuilder(&b, names, sorted, NULL, names->numInstances, options, numTargets * names->numClasses))
+    return NULL;
+
+  DecisionTreeNode** roots = (DecisionTreeNode**)malloc(sizeof(DecisionTreeNode*) * numTargets);
+  learnTargets(&b, classes, numTargets, 0, names->numInstances, 0, roots);
+
+  DecisionTree** trees = (DecisionTree**)malloc(sizeof(DecisionTree*) * numTargets);
+  for (int t = 0; t < numTargets; t++) {
+    trees[t] = (DecisionTree*)malloc(sizeof(DecisionTree));
+    trees[t]->root = roots[t];
+  }
+
+  free(roots);
+  freeBuilder(&b);
+  return trees;
+}
@@ -0,0 +1,45 @@
+#ifndef PRESORT_H_
+#define PRESORT_H_
+
+#include "input.h"
+#include "decision_tree.h"
+
+// Options
+typedef struct TrainOptions {
+  int maxDepth; // Nodes at this depth become leaves (the root is depth 0), 0 for no limit
+  int minSplit; // Nodes with fewer instances than this become leaves, 0 for no limit
+
+  // Budgets: if any is set, the tree grows best-first (the leaf whose split removes the most entropy next)
+  // and stops once the next split doesn't fit or time is up, so the tree is usable at any size
+  int maxLeaves;     // Most leaves the tree may have, 0 for no limit
+  long memoryBudget; // Most bytes the tree's nodes may take, 0 for no limit
+  double timeLimit;  // Seconds of wall-clock time after which no more leaves are split, 0 for no limit
+} TrainOptions;
+
+void defaultTrainOptions(TrainOptions* options);
+
+
+
+// Sorted Features
+typedef struct SortedFeatures { // Column copy of the instances, sorted once and shared by every build
+  int numFeatures;
+  int numInstances;
+  int numClasses;
+
+  int* classes;      // classes[i] is the class of instance i
+  int* weights;      // weights[i] is the number of instances instance i stands for
+  int* classWeights; // classWeights[i * numClasses + c] of them have class c (NULL if no instance is weighted)
+  double** columns;  // columns[f][i] is the value of feature f for instance i
+  int** order;       // order[f] holds the instance indices sorted by feature f (ties broken by index)
+} SortedFeatures;
+
+SortedFeatures* sortFeatures(Names* names);
+void freeSortedFeatures(SortedFeatures* sorted);
+
+
+
+// Tree
+DecisionTree* makeTreeSorted(Names* names, SortedFeatures* sorted, int* rows, int numRows, TrainOptions* options);
+DecisionTree** makeTreesSorted(Names* names, SortedFeatures* sorted, TrainOptions* options);
+
+#endif
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "quantize.h"
+#include "decision_tree.h"
+
+// Bin Table
+
+// Counts the cuts the decision nodes of the subtree put on each feature (before duplicates are removed)
+static void countCuts(DecisionTreeNode* node, int* numCuts) {
+  if (node->isLeaf)
+    return;
+
+  if (node->isCategorical) {
+    numCuts[node->info.category.feature] += node->info.category.numCodes + 1;
+    countCuts(node->info.category.left, numCuts);
+    countCuts(node->info.category.right, numCuts);
+  } else {
+    numCuts[node->info.decision.feature]++;
+    countCuts(node->info.decision.left, numCuts);
+    countCuts(node->info.decision.right, numCuts);
+  }
+}
+
+// Adds the cuts of the subtree's decision nodes: a split at s is the cut (s, exclusive), since values <= s
+// go left, and a jump table from minCode puts an inclusive cut at every code boundary from minCode to
+// minCode + numCodes, since code k covers [minCode + k, minCode + k + 1)
+static void addCuts(DecisionTreeNode* node, QuantCut** cuts, int* numCuts) {
+  if (node->isLeaf)
+    return;
+
+  if (node->isCategorical) {
+    int f = node->info.category.feature;
+    for (int k = 0; k <= node->info.category.numCodes; k++) {
+      cuts[f][numCuts[f]].value = (double) node->info.category.minCode + k;
+      cuts[f][numCuts[f]].inclusive = 1;
+      numCuts[f]++;
+    }
+    addCuts(node->info.category.left, cuts, numCuts);
+    addCuts(node->info.category.right, cuts, numCuts);
+  } else {
+    int f = node->info.decision.feature;
+    cuts[f][numCuts[f]].value = node->info.decision.split;
+    cuts[f][numCuts[f]].inclusive = 0;
+    numCuts[f]++;
+    addCuts(node->info.decision.left, cuts, numCuts);
+    addCuts(node->info.decision.right, cuts, numCuts);
+  }
+}
+
+// qsort comparator: ascending by value, inclusive cuts before exclusive ones at the same value
+// In this order the cuts a value is above always come first, so its code is a prefix length
+static int compareCut(const void* a, const void* b) {
+  const QuantCut* x = (const QuantCut*) a;
+  const QuantCut* y = (const QuantCut*) b;
+  if (x->value < y->value) return -1;
+  if (x->value > y->value) return 1;
+  return (int) y->inclusive - (int) x->inclusive;
+}
+
+// Returns 1 if the value is above the cut
+static inline _Bool aboveCut(QuantCut* cut, double value) {
+  return cut->inclusive ? value >= cut->value : value > cut->value;
+}
+
+// Returns the index of a cut of the feature (which must exist)
+static int findCut(QuantTree* quant, int feature, double value, _Bool inclusive) {
+  QuantCut key = { value, inclusive };
+  QuantCut* cut = (QuantCut*)bsearch(&key, quant->cuts[feature], quant->numCuts[feature], sizeof(QuantCut), compareCut);
+  assert(cut != NULL);
+  return (int) (cut - quant->cuts[feature]);
+}
+
+// Returns the code of a value of the feature: the number of the feature's cuts it is above
+// The code takes a row to the same child at every node as the value does in classify (for categorical
+// features, as long as the value minus the node's minCode is exact, as it is for integer codes)
+int quantizeValue(QuantTree* quant, int feature, double value) {
+  QuantCut* cuts = quant->cuts[feature];
+  int lo = 0;
+  int hi = quant->numCuts[feature];
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (aboveCut(&cuts[mid], value))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Quantizes numRows rows of feature values (row-major) into codes of codeBytes bytes each, in the same layout
+void quantizeRows(QuantTree* quant, double* rows, int numRows, void* codes) {
+  assert(quant != NULL);
+  assert(numRows == 0 || (rows != NULL && codes != NULL));
+  long numValues = (long) numRows * quant->numFeatures;
+  for (long i = 0; i < numValues; i++) {
+    int code = quantizeValue(quant, (int) (i % quant->numFeatures), rows[i]);
+    if (quant->codeBytes == 1)
+      ((unsigned char*) codes)[i] = (unsigned char) code;
+    else
+      ((unsigned short*) codes)[i] = (unsigned short) code;
+  }
+}
+
+
+
+// Quantized Tree
+
+// Counts the nodes of the subtree and the jump table entries its categorical nodes need
+static void measureQuant(QuantTree* quant, DecisionTreeNode* node, int* numNodes, int* numLinks) {
+  (*numNodes)++;
+  if (node->isLeaf)
+    return;
+
+  if (node->isCategorical) {
+    int f = node->info.category.feature;
+    int first = findCut(quant, f, node->info.category.minCode, 1) + 1;
+    int last = findCut(quant, f, (double) node->info.category.minCode + node->info.category.numCodes, 1);
+    *numLinks += last - first + 2;
+    measureQuant(quant, node->info.category.left, numNodes, numLinks);
+    measureQuant(quant, node->info.category.right, numNodes, numLinks);
+  } else {
+    measureQuant(quant, node->info.decision.left, numNodes, numLinks);
+    measureQuant(quant, node->info.decision.right, numNodes, numLinks);
+  }
+}
+
+// Appends the node and its subtree in preorder, left child first, and returns its index
+static int appendQuant(QuantTree* quant, DecisionTreeNode* node) {
+  int index = quant->numNodes;
+  quant->numNodes++;
+  QuantNode* out = &quant->nodes[index];
+  out->feature = -1;
+  out->threshold = 0;
+  out->numCodes = 0;
+
+  if (node->isLeaf) {
+    out->value = node->info.class;
+  } else if (node->isCategorical) {
+    // the codes from the cut at minCode + k to the cut at minCode + k + 1 all go where code k does
+    int f = node->info.category.feature;
+    int minCode = node->info.category.minCode;
+    int numTableCodes = node->info.category.numCodes;
+    int first = findCut(quant, f, minCode, 1) + 1;
+    int numCodes = findCut(quant, f, (double) minCode + numTableCodes, 1) - first + 1;
+    int table = quant->numLinks;
+    quant->numLinks += numCodes + 1;
+    out->feature = f;
+    out->threshold = (unsigned short) first;
+    out->numCodes = (unsigned short) numCodes;
+    out->value = table;
+
+    int left = appendQuant(quant, node->info.category.left);
+    int right = appendQuant(quant, node->info.category.right);
+    int from = first;
+    for (int k = 0; k < numTableCodes; k++) {
+      int to = findCut(quant, f, (double) minCode + k + 1, 1);
+      for (int code = from; code <= to; code++)
+	quant->links[table + code - first] = node->info.category.inLeft[k] ? left : right;
+      from = to + 1;
+    }
+    quant->links[table + numCodes] = right;
+  } else {
+    int f = node->info.decision.feature;
+    out->feature = f;
+    out->threshold = (unsigned short) findCut(quant, f, node->info.decision.split, 0);
+    appendQuant(quant, node->info.decision.left);
+    quant->nodes[index].value = appendQuant(quant, node->info.decision.right);
+  }
+
+  return index;
+}
+
+// Builds the bin table of every feature from the tree's thresholds and lays the tree out over codes
+// A row's codes then take it to the same leaf as its feature values take it in classify, with integer
+// compares on a node array a third the size of the tree's. Returns NULL if a feature has more than MAX_CUTS cuts.
+QuantTree* quantizeTree(DecisionTreeNode* root, int numFeatures) {
+  assert(root != NULL);
+  assert(numFeatures > 0);
+
+  QuantTree* quant = (QuantTree*)malloc(sizeof(QuantTree));
+  quant->numFeatures = numFeatures;
+  quant->numCuts = (int*)calloc(numFeatures, sizeof(int));
+  quant->cuts = (QuantCut**)malloc(sizeof(QuantCut*) * numFeatures);
+  quant->cutValues = NULL;
+  quant->cutInclusive = NULL;
+  quant->nodes = NULL;
+  quant->links = NULL;
+  quant->numNodes = 0;
+  quant->numLinks = 0;
+
+  // gather every feature's cuts, then sort them and drop duplicates
+  countCuts(root, quant->numCuts);
+  for (int f = 0; f < numFeatures; f++) {
+    quant->cuts[f] = (QuantCut*)malloc(sizeof(QuantCut) * (quant->numCuts[f] > 0 ? quant->numCuts[f] : 1));
+    quant->numCuts[f] = 0;
+  }
+  addCuts(root, quant->cuts, quant->numCuts);
+
+  int maxCuts = 0;
+  for (int f = 0; f < numFeatures; f++) {
+    qsort(quant->cuts[f], quant->numCuts[f], sizeof(QuantCut), compareCut);
+    int numUnique = 0;
+    for (int j = 0; j < quant->numCuts[f]; j++)
+      if (numUnique == 0 || compareCut(&quant->cuts[f][numUnique - 1], &quant->cuts[f][j]) != 0) {
+	quant->cuts[f][numUnique] = quant->cuts[f][j];
+	numUnique++;
+      }
+    quant->numCuts[f] = numUnique;
+    if (numUnique > maxCuts)
+      maxCuts = numUnique;
+  }
+  if (maxCuts > MAX_CUTS) {
+    freeQuantTree(quant);
+    return NULL;
+  }
+  quant->codeBytes = maxCuts <= 255 ? 1 : 2;
+
+  // the same cuts split into plain arrays of values and flags
+  quant->cutValues = (double**)malloc(sizeof(double*) * numFeatures);
+  quant->cutInclusive = (unsigned char**)malloc(sizeof(unsigned char*) * numFeatures);
+  for (int f = 0; f < numFeatures; f++) {
+    int n = quant->numCuts[f] > 0 ? quant->numCuts[f] : 1;
+    quant->cutValues[f] = (double*)malloc(sizeof(double) * n);
+    quant->cutInclusive[f] = (unsigned char*)malloc(sizeof(unsigned char) * n);
+    for (int j = 0; j < quant->numCuts[f]; j++) {
+      quant->cutValues[f][j] = quant->cuts[f][j].value;
+      quant->cutInclusive[f][j] = quant->cuts[f][j].inclusive;
+    }
+  }
+
+  int numNodes = 0;
+  int numLinks = 0;
+  measureQuant(quant, root, &numNodes, &numLinks);
+  quant->nodes = (QuantNode*)malloc(sizeof(QuantNode) * numNodes);
+  quant->links = (int*)malloc(sizeof(int) * (numLinks > 0 ? numLinks : 1));
+  appendQuant(quant, root);
+  return quant;
+}
+
+// Returns the index of the child of a quantized decision node that a row with the given code goes to
+static inline int quantChild(QuantTree* quant, int index, int code) {
+  QuantNode* node = &quant->nodes[index];
+  if (node->numCodes == 0)
+    return code <= node->threshold ? index + 1 : node->value;
+
+  // jump table; codes outside it go to the entry after it
+  unsigned int entry = (unsigned int) (code - node->threshold);
+  return quant->links[node->value + (entry < node->numCodes ? entry : node->numCodes)];
+}
+
+// Returns the class of a row of one byte codes
+static inline int classifyCodes8(QuantTree* quant, unsigned char* codes) {
+  int index = 0;
+  while (quant->nodes[index].feature >= 0)
+    index = quantChild(quant, index, codes[quant->nodes[index].feature]);
+  return quant->nodes[index].value;
+}
+
+// Returns the class of a row of two byte codes
+static inline int classifyCodes16(QuantTree* quant, unsigned short* codes) {
+  int index = 0;
+  while (quant->nodes[index].feature >= 0)
+    index = quantChild(quant, index, codes[quant->nodes[index].feature]);
+  return quant->nodes[index].value;
+}
+
+// Returns the class of one row of codes (as written by quantizeRows)
+int classifyCodes(QuantTree* quant, void* codes) {
+  assert(quant != NULL);
+  assert(codes != NULL);
+  if (quant->codeBytes == 1)
+    return classifyCodes8(quant, (unsigned char*) codes);
+  return classifyCodes16(quant, (unsigned short*) codes);
+}
+
+// Classifies numRows rows of codes (row-major, as written by quantizeRows) into classes
+void classifyCodesBatch(QuantTree* quant, void* codes, int numRows, int* classes) {
+  assert(quant != NULL);
+  assert(numRows == 0 || (codes != NULL && classes != NULL));
+  if (quant->codeBytes == 1) {
+    unsigned char* rows = (unsigned char*) codes;
+    for (int r = 0; r < numRows; r++)
+      classes[r] = classifyCodes8(quant, rows + (long) r * quant->numFeatures);
+  } else {
+    unsigned short* rows = (unsigned short*) codes;
+    for (int r = 0; r < numRows; r++)
+      classes[r] = classifyCodes16(quant, rows + (long) r * quant->numFeatures);
+  }
+}
+
+// Frees the tables, the nodes and the structure itself
+void freeQuantTree(QuantTree* quant) {
+  for (int f = 0; f < quant->numFeatures; f++)
+    free(quant->cuts[f]);
+  free(quant->cuts);
+  if (quant->cutValues) {
+    for (int f = 0; f < quant->numFeatures; f++) {
+      free(quant->cutValues[f]);
+      free(quant->cutInclusive[f]);
+    }
+    free(quant->cutValues);
+    free(quant->cutInclusive);
+  }
+  free(quant->numCuts);
+  free(quant->nodes);
+  free(quant->links);
+  free(quant);
+}
@@ -0,0 +1,44 @@
+#ifndef QUANTIZE_H_
+#define QUANTIZE_H_
+
+#include "decision_tree.h"
+
+#define MAX_CUTS 65535 // Most cuts a feature can have, so its codes fit in an unsigned short
+
+// Bin Table
+typedef struct QuantCut { // A point where a feature's code goes up by one
+  double value;
+  _Bool inclusive; // Values equal to value are above the cut (categorical code boundaries), else only greater ones are
+} QuantCut;
+
+
+
+// Quantized Tree
+typedef struct QuantNode { // A node of a tree that compares codes instead of feature values
+  int feature;              // The feature to split on, -1 for a leaf
+  unsigned short threshold; // Split: rows whose code is <= this go to the next node. Table: code of the first entry
+  unsigned short numCodes;  // Table: number of entries (0 for a binary split)
+  int value;                // Leaf: the class. Split: index of the other child. Table: offset of the table in links
+} QuantNode;
+
+typedef struct QuantTree {
+  int numFeatures;
+  int codeBytes;    // Width of a code: 1 (unsigned char) if every feature has at most 255 cuts, else 2 (unsigned short)
+  int* numCuts;     // numCuts[f] is the number of cuts of feature f; its codes are 0 to numCuts[f]
+  QuantCut** cuts;  // cuts[f] in increasing order; a value's code is the number of cuts it is above
+  double** cutValues;           // cutValues[f][j] is cuts[f][j].value, for handing the table out
+  unsigned char** cutInclusive; // cutInclusive[f][j] is cuts[f][j].inclusive
+  QuantNode* nodes; // In preorder with the left child right after its parent
+  int numNodes;
+  int* links;       // Jump tables of the categorical nodes, each followed by the child for other codes
+  int numLinks;
+} QuantTree;
+
+QuantTree* quantizeTree(DecisionTreeNode* root, int numFeatures);
+int quantizeValue(QuantTree* quant, int feature, double value);
+void quantizeRows(QuantTree* quant, double* rows, int numRows, void* codes);
+int classifyCodes(QuantTree* quant, void* codes);
+void classifyCodesBatch(QuantTree* quant, void* codes, int numRows, int* classes);
+void freeQuantTree(QuantTree* quant);
+
+#endif
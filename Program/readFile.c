@@ -1,175 +1,822 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <time.h>
 #include "decision_tree.h"
 #include "input.h"
+#include "presort.h"
+#include "cross_validation.h"
+#include "hoeffding.h"
+#include "sparse.h"
+#include "boost.h"
+#include "model_cache.h"
+#include "dtree.h"
 
-#define BUFFER_SIZE 256
+#define MAX_VALUES 64 // Most values accepted in one comma separated option
+#define STREAM_BATCH 4096 // Instances parsed at a time when streaming
+
+// Reads a comma separated list of integers (e.g. "0,4,8") into values and returns how many were read
+int parseIntList(char* text, int* values) {
+  int count = 0;
+  char* end;
+  while (count < MAX_VALUES) {
+    values[count] = (int) strtol(text, &end, 10);
+    if (end == text)
+      break;
+    count++;
+    text = end;
+    if (*text != ',')
+      break;
+    text++;
+  }
+  return count;
+}
+
+// Returns the current time of a monotonic clock in seconds
+double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Streams the instances left in the file through a Hoeffding tree and returns the tree it grows
+// Instances are parsed a batch at a time so the learner's own throughput can be reported
+DecisionTree* learnOnline(FILE* file, int numClasses, int numFeatures, long memoryBudget) {
+  HoeffdingOptions options;
+  defaultHoeffdingOptions(&options);
+  options.memoryBudget = memoryBudget;
+  HoeffdingTree* learner = makeHoeffdingTree(numClasses, numFeatures, &options);
+
+  char line[BUFFER_SIZE];
+  Instance* batch[STREAM_BATCH];
+  double seconds = 0;
+  _Bool more = 1;
+  while (more) {
+    int numBatch = 0;
+    while (numBatch < STREAM_BATCH && (more = (fgets(line, sizeof(line), file) != NULL))) {
+      if (learner->numInstances == 0 && numBatch == 0 && isTypesLine(line)) {
+	printf("Warning: -o treats every feature as ordered, so the types line is ignored.\n");
+	continue;
+      }
+      batch[numBatch] = parseInstance(line, numFeatures, numClasses);
+      if (batch[numBatch])
+	numBatch++;
+    }
+
+    double start = now();
+    for (int i = 0; i < numBatch; i++)
+      hoeffdingUpdate(learner, batch[i]->featureValues, batch[i]->class);
+    seconds += now() - start;
+
+    for (int i = 0; i < numBatch; i++)
+      freeInstance(batch[i]);
+  }
+
+  printf("Learned online from %ld instances in %lf seconds (%.0lf instances/second), nodes and leaf statistics: %ld bytes\n",
+	 learner->numInstances, seconds, seconds > 0 ? learner->numInstances / seconds : 0.0, learner->memoryUsed);
+  return finishHoeffdingTree(learner);
+}
+
+// Returns the class of a row of feature values from a model of some kind
+typedef int (*RowClassifier)(void* model, double* featureValues);
+
+// Returns the tree's class of the row
+int treeClass(void* tree, double* featureValues) {
+  return classifyValues((DecisionTree*) tree, featureValues);
+}
+
+// Returns the library model's class of the row
+int modelClass(void* model, double* featureValues) {
+  int class;
+  dtreeClassify((DTreeModel*) model, featureValues, &class);
+  return class;
+}
+
+// Classifies each instance in the testing file (if any) with the model and prints the accuracy
+void testModel(RowClassifier classifyRow, void* model, int numFeatures, int numClasses, FILE* testFile) {
+  if (!testFile)
+    return;
+
+  printf("\nTESTING DATA:\n");
+  char line[BUFFER_SIZE]; // Read each line in file into here
+  int numInstances = 0; // Keep track of number of instance
+  int countCorrect = 0; // Keep track of how many instances have been classified by the tree correctly
+
+  // READ IN DATA
+  // Read each line
+  while (fgets(line, sizeof(line), testFile)) {
+
+    // Create an instance
+    Instance* instance = parseInstance(line, numFeatures, numClasses);
+    if (!instance)
+      continue;
+
+    // Test it
+    printInstance(instance, numFeatures);
+    int class = classifyRow(model, instance->featureValues);
+    printf("\nTree classifies as %d\n\n", class);
+    if (class == instance->class)
+      countCorrect++;
+    numInstances++;
+
+    // Free it
+    freeInstance(instance);
+  }
+
+  printf("Accuracy of tree on testing data: %f\n", (double) countCorrect / (double) numInstances);
+  fclose(testFile);
+}
+
+// Trains one tree per target on the shared features, prints them with their accuracy on the
+// training data, and tests them on the testing file (if any), whose lines hold every target's class
+// Every tree is grown with the same options as a single tree. Returns 0 if the trees' buffers couldn't be allocated.
+_Bool learnEachTarget(Names* names, TrainOptions* options, FILE* testFile) {
+  int numTargets = names->numTargets;
+
+  double start = now();
+  SortedFeatures* sorted = sortFeatures(names);
+  DecisionTree** trees = sorted ? makeTreesSorted(names, sorted, options) : NULL;
+  if (!trees) {
+    if (sorted)
+      freeSortedFeatures(sorted);
+    if (testFile)
+      fclose(testFile);
+    return 0;
+  }
+  printf("Trained %d trees on %d instances in %lf seconds\n", numTargets, names->numInstances, now() - start);
+  freeSortedFeatures(sorted);
+
+  for (int t = 0; t < numTargets; t++) {
+    int countCorrect = 0;
+    for (int i = 0; i < names->numInstances; i++)
+      if (classify(trees[t], names->instances[i]) == names->targets[t][i])
+	countCorrect++;
+    printf("\nTree of target %d:\n", t);
+    printTree(trees[t]->root, 0);
+    printf("\nAccuracy of tree %d on training data: %lf\n", t, (double) countCorrect / (double) names->numInstances);
+  }
+
+  if (testFile) {
+    char line[BUFFER_SIZE];
+    int targets[BUFFER_SIZE];
+    int numInstances = 0;
+    int* countCorrect = (int*)calloc(numTargets, sizeof(int));
+    while (fgets(line, sizeof(line), testFile)) {
+      Instance* instance = parseInstanceTargets(line, names->numFeatures, names->numClasses, targets, numTargets);
+      if (!instance)
+	continue;
+      for (int t = 0; t < numTargets; t++)
+	if (classify(trees[t], instance) == targets[t])
+	  countCorrect[t]++;
+      numInstances++;
+      freeInstance(instance);
+    }
+    fclose(testFile);
+
+    printf("\nTESTING DATA:\n");
+    for (int t = 0; t < numTargets; t++)
+      printf("Accuracy of tree %d on testing data: %lf\n", t, (double) countCorrect[t] / (double) numInstances);
+    free(countCorrect);
+  }
+
+  for (int t = 0; t < numTargets; t++) {
+    freeTree(trees[t]->root);
+    free(trees[t]);
+  }
+  free(trees);
+  return 1;
+}
+
+// Reads the instances of a file formatted like a testing file and returns them, with their number
+// in numInstances. Lines with more than one class (of a multi-target file) count the first one.
+Instance** readInstances(FILE* file, int numFeatures, int numClasses, int* numInstances) {
+  char line[BUFFER_SIZE];
+  int capacity = 64;
+  Instance** instances = (Instance**)malloc(sizeof(Instance*) * capacity);
+  *numInstances = 0;
+  while (fgets(line, sizeof(line), file)) {
+    Instance* instance = parseInstance(line, numFeatures, numClasses);
+    if (!instance)
+      continue;
+    if (*numInstances == capacity) {
+      capacity *= 2;
+      instances = (Instance**)realloc(instances, sizeof(Instance*) * capacity);
+    }
+    instances[*numInstances] = instance;
+    (*numInstances)++;
+  }
+  return instances;
+}
+
+// Reads the instances of a sample file (formatted like a testing file) into rows of feature values
+// and returns them, with their number in numRows
+double* readSample(FILE* file, int numFeatures, int numClasses, int* numRows) {
+  Instance** instances = readInstances(file, numFeatures, numClasses, numRows);
+  double* rows = (double*)malloc(sizeof(double) * (*numRows > 0 ? *numRows : 1) * numFeatures);
+  for (int r = 0; r < *numRows; r++)
+    memcpy(rows + (long) r * numFeatures, instances[r]->featureValues, sizeof(double) * numFeatures);
+  freeArrayAndInstances(instances, *numRows);
+  return rows;
+}
+
+// Collapses the model's redundant splits, lays it out for the sample rows and prints what changed
+void optimizeModel(DTreeModel* model, double* sample, int numRows) {
+  DTreeOptimizeReport report;
+  dtreeOptimize(model, sample, numRows, &report);
+  printf("Optimized on %d rows: %d -> %d nodes, average path length %lf -> %lf, branches to the next node %.1lf%% -> %.1lf%%\n",
+	 numRows, report.numNodesBefore, report.numNodesAfter, report.pathLengthBefore, report.pathLengthAfter,
+	 100 * report.nextFractionBefore, 100 * report.nextFractionAfter);
+}
+
+// Quantizes the model, then classifies the rows from their codes and prints how long that takes next to
+// classifying their feature values, and whether the classes agree
+void quantizeModel(DTreeModel* model, double* rows, int numRows) {
+  int codeBytes;
+  DTreeStatus status = dtreeQuantize(model, &codeBytes);
+  if (status != DTREE_OK) {
+    printf("Quantizing failed: %s\n", dtreeStatusMessage(status));
+    return;
+  }
+
+  void* codes = malloc((long) numRows * dtreeNumFeatures(model) * codeBytes);
+  int* classes = (int*)malloc(sizeof(int) * numRows);
+  int* codeClasses = (int*)malloc(sizeof(int) * numRows);
+
+  double start = now();
+  dtreeClassifyBatch(model, rows, numRows, classes);
+  double valueSeconds = now() - start;
+  start = now();
+  dtreeQuantizeRows(model, rows, numRows, codes);
+  double quantizeSeconds = now() - start;
+  start = now();
+  dtreeClassifyQuantized(model, codes, numRows, codeClasses);
+  double codeSeconds = now() - start;
+
+  int numAgree = 0;
+  for (int i = 0; i < numRows; i++)
+    if (classes[i] == codeClasses[i])
+      numAgree++;
+  printf("Quantized to %d byte codes: %d rows quantized in %lf seconds and classified in %lf seconds (%lf seconds from values), %d of %d classes agree\n",
+	 codeBytes, numRows, quantizeSeconds, codeSeconds, valueSeconds, numAgree, numRows);
+
+  free(codes);
+  free(classes);
+  free(codeClasses);
+}
+
+// Returns the feature values of the instances as rows (row-major)
+double* namesToRows(Names* names) {
+  int numFeatures = names->numFeatures;
+  double* rows = (double*)malloc(sizeof(double) * names->numInstances * numFeatures);
+  for (int i = 0; i < names->numInstances; i++)
+    memcpy(rows + (long) i * numFeatures, names->instances[i]->featureValues, sizeof(double) * numFeatures);
+  return rows;
+}
+
+// Trains a model on the instances through the library with the options, folding duplicates first if asked to
+// Returns NULL after printing the library's error if training fails
+DTreeModel* trainModel(Names* names, DTreeOptions* options, _Bool deduplicate) {
+  int numFeatures = names->numFeatures;
+  double* features = namesToRows(names);
+  int* classes = (int*)malloc(sizeof(int) * names->numInstances);
+  unsigned char* categorical = NULL;
+  for (int i = 0; i < names->numInstances; i++)
+    classes[i] = names->instances[i]->class;
+  if (names->categorical) {
+    categorical = (unsigned char*)malloc(numFeatures);
+    for (int f = 0; f < numFeatures; f++)
+      categorical[f] = names->categorical[f];
+  }
+
+  DTreeDataset* dataset = NULL;
+  DTreeModel* model = NULL;
+  DTreeStatus status = dtreeDatasetCreate(features, classes, names->numInstances, numFeatures, names->numClasses, categorical, &dataset);
+  if (status == DTREE_OK && deduplicate) {
+    int numUnique;
+    status = dtreeDatasetDeduplicate(dataset, &numUnique);
+    printf("Folded %d instances into %d unique instances\n", names->numInstances, numUnique);
+  }
+  if (status == DTREE_OK) {
+    double start = now();
+    status = dtreeTrain(dataset, options, &model);
+    if (status == DTREE_OK)
+      printf("Trained a tree with %d nodes in %lf seconds\n", dtreeNumNodes(model), now() - start);
+  }
+  if (status != DTREE_OK)
+    printf("Training failed: %s\n", dtreeStatusMessage(status));
+
+  dtreeDatasetFree(dataset);
+  free(features);
+  free(classes);
+  free(categorical);
+  return model;
+}
+
+// Optimizes the model on the sample rows (the training rows if sample is NULL) if optimize is set,
+// quantizes it and checks it on the training rows if quantize is set, then prints it with its
+// accuracy on the training data
+void reportModel(DTreeModel* model, Names* names, _Bool optimize, _Bool quantize, double* sample, int numSample) {
+  double* features = namesToRows(names);
+  if (optimize)
+    optimizeModel(model, sample ? sample : features, sample ? numSample : names->numInstances);
+  if (quantize)
+    quantizeModel(model, features, names->numInstances);
+
+  // accuracy on the training data, in one batch
+  int* predicted = (int*)malloc(sizeof(int) * names->numInstances);
+  dtreeClassifyBatch(model, features, names->numInstances, predicted);
+  int countCorrect = 0;
+  for (int i = 0; i < names->numInstances; i++)
+    if (predicted[i] == names->instances[i]->class)
+      countCorrect++;
+  printf("\nTree:\n");
+  dtreePrint(model, stdout);
+  printf("\nAccuracy of tree on training data: %lf\n", (double) countCorrect / (double) names->numInstances);
+
+  free(predicted);
+  free(features);
+}
+
+// Optimizes a model that was loaded instead of trained on the sample file's rows (if optimize is set),
+// prints it and tests it on the testing file (if any), then frees it. Returns -1 if the sample file is missing
+int runLoadedModel(DTreeModel* model, _Bool optimize, char* sampleFileName, FILE* testFile) {
+  if (optimize) {
+    int numSample = 0;
+    double* sample = NULL;
+    if (sampleFileName) {
+      FILE* sampleFile = fopen(sampleFileName, "r");
+      if (!sampleFile) {
+	printf("Sample file '%s' not found.\n", sampleFileName);
+	dtreeModelFree(model);
+	return -1;
+      }
+      sample = readSample(sampleFile, dtreeNumFeatures(model), dtreeNumClasses(model), &numSample);
+      fclose(sampleFile);
+    }
+    optimizeModel(model, sample, numSample);
+    free(sample);
+  }
+
+  printf("\nTree:\n");
+  dtreePrint(model, stdout);
+
+  testModel(modelClass, model, dtreeNumFeatures(model), dtreeNumClasses(model), testFile);
+  dtreeModelFree(model);
+  return 0;
+}
+
+// Returns the cache key of a training run: the training file's contents, the info file's (if any),
+// the options that shape the tree and the cache version. Folding duplicates doesn't change the tree,
+// so it isn't part of the key. Returns 0 in ok if a file couldn't be read.
+CacheKey trainingKey(FILE* trainFile, char* infoFileName, DTreeOptions* options, _Bool* ok) {
+  CacheKey key;
+  cacheKeyInit(&key);
+  *ok = cacheKeyAddFile(&key, trainFile);
+
+  _Bool hasInfo = infoFileName != NULL;
+  cacheKeyAdd(&key, &hasInfo, sizeof(hasInfo));
+  if (hasInfo) {
+    FILE* infoFile = fopen(infoFileName, "r");
+    *ok = *ok && infoFile && cacheKeyAddFile(&key, infoFile);
+    if (infoFile)
+      fclose(infoFile);
+  }
+
+  cacheKeyAdd(&key, &options->maxDepth, sizeof(options->maxDepth));
+  cacheKeyAdd(&key, &options->minSplit, sizeof(options->minSplit));
+  cacheKeyAdd(&key, &options->maxLeaves, sizeof(options->maxLeaves));
+  cacheKeyAdd(&key, &options->memoryBudget, sizeof(options->memoryBudget));
+  return key;
+}
+
+// Boosts an ensemble on the instances, prints how long it took and its accuracy on the training data,
+// and tests it on the testing file (if any). Returns 0 if the features' sort orders couldn't be allocated.
+_Bool learnBoosted(Names* names, BoostOptions* options, FILE* testFile) {
+  double start = now();
+  SortedFeatures* sorted = sortFeatures(names);
+  if (!sorted) {
+    if (testFile)
+      fclose(testFile);
+    return 0;
+  }
+  BinnedFeatures* binned = binFeatures(sorted, options->maxBins);
+  Ensemble* ensemble = makeEnsemble(sorted, binned, options);
+  printf("Boosted %d rounds (%d trees, %d nodes) of depth %d on %d instances in %lf seconds\n", options->numRounds,
+	 ensemble->numTrees, ensemble->numNodes, options->maxDepth, names->numInstances, now() - start);
+  freeBinnedFeatures(binned);
+  freeSortedFeatures(sorted);
+
+  printf("\nAccuracy of ensemble on training data: %lf\n",
+	 ensembleAccuracy(ensemble, names->instances, names->numInstances, options->numThreads));
+
+  if (testFile) {
+    int numInstances;
+    Instance** instances = readInstances(testFile, names->numFeatures, names->numClasses, &numInstances);
+    fclose(testFile);
+
+    printf("\nTESTING DATA:\n");
+    if (numInstances > 0) {
+      start = now();
+      double testAccuracy = ensembleAccuracy(ensemble, instances, numInstances, options->numThreads);
+      printf("Classified %d instances in %lf seconds\n", numInstances, now() - start);
+      printf("Accuracy of ensemble on testing data: %lf\n", testAccuracy);
+    }
+    freeArrayAndInstances(instances, numInstances);
+  }
+
+  freeEnsemble(ensemble);
+  return 1;
+}
+
+void printUsage(char const* program) {
+  printf("Usage: %s [options] training-file [testing-file]\n", program);
+  printf("       %s -l model-file [testing-file]\n", program);
+  printf("  -k folds      Run k-fold cross-validation instead of training a single tree\n");
+  printf("  -d depths     Comma separated maximum depths to try (0 for no limit)\n");
+  printf("  -m minSplits  Comma separated minimum node sizes to try (0 for no limit)\n");
+  printf("  -t threads    Threads used by cross-validation (default: one per processor)\n");
+  printf("  -s seed       Seed for assigning instances to folds\n");
+  printf("  -o            Learn online: stream the training file through a Hoeffding tree\n");
+  printf("  -b bytes      Memory budget for the online learner's nodes and leaf statistics or the best-first tree (0 for no limit)\n");
+  printf("  -q            Quantize the tree and check classifying the training rows from integer codes\n");
+  printf("  -c directory  Cache trained trees in this directory (e.g. .dtree-cache); the cache is off without it\n");
+  printf("  -e bytes      Most bytes the cache may take before the least recently used trees are removed (0 for no limit)\n");
+  printf("  -x            Don't use the cache even if -c is given\n");
+  printf("  -n leaves     Grow the tree best-first, up to this many leaves\n");
+  printf("  -T seconds    Grow the tree best-first, splitting leaves until this much time has passed\n");
+  printf("  -u            Fold identical instances into weighted instances before training\n");
+  printf("  -p            Sparse input: libsvm-style \"label feature:value ...\" lines, with or without the header line\n");
+  printf("  -i info-file  Read which features are categorical from an .info file (see data/cars.info)\n");
+  printf("  -w model-file Save the trained tree to a model file\n");
+  printf("  -l model-file Load a saved tree instead of training one\n");
+  printf("  -O            Optimize the tree: collapse redundant splits and put each node's frequent child first\n");
+  printf("  -f file       Measure the branch frequencies for -O on this file's rows instead of the training rows\n");
+  printf("  -g rounds     Boost an ensemble of regression trees (depth from -d, default 6) instead of one tree\n");
+  printf("  -r rate       Learning rate of the boosted trees (default 0.1)\n");
+}
 
 int main(int argc, char* argv[]) {
 
+  //OPTIONS
+
+  int numFolds = 0; // Cross-validation folds (0 to train a single tree)
+  int depths[MAX_VALUES] = {0};
+  int numDepths = 1;
+  int minSplits[MAX_VALUES] = {0};
+  int numMinSplits = 1;
+  int numThreads = 0;
+  unsigned int seed = 1;
+  _Bool online = 0; // Stream the instances through a Hoeffding tree instead of loading them
+  long memoryBudget = 0;
+  char* cacheDirectory = NULL; // Where trained trees are kept for runs with the same input, NULL for no cache
+  long cacheBytes = 64L << 20;
+  _Bool useCache = 1;
+  _Bool quantize = 0; // Classify the training rows from codes of the tree's bins as well
+  int maxLeaves = 0; // Best-first budgets of a single tree (0 for no limit)
+  double timeLimit = 0;
+  char* infoFileName = NULL; // Feature types (OPTIONAL)
+  _Bool deduplicate = 0; // Fold identical instances into weighted ones
+  _Bool sparse = 0; // The input files are in the sparse format
+  char* saveFileName = NULL; // Where to save the trained model (OPTIONAL)
+  char* loadFileName = NULL; // Model to load instead of training one (OPTIONAL)
+  _Bool optimize = 0; // Collapse redundant splits and lay the tree out by branch frequency
+  char* sampleFileName = NULL; // Rows to measure branch frequencies on (OPTIONAL, the training rows by default)
+  BoostOptions boostOptions; // Used if the number of rounds is set
+  defaultBoostOptions(&boostOptions);
+  boostOptions.numRounds = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "k:d:m:t:s:ob:i:upw:l:Of:g:r:n:T:qc:e:x")) != -1) {
+    switch (opt) {
+    case 'k': numFolds = atoi(optarg); break;
+    case 'd': numDepths = parseIntList(optarg, depths); break;
+    case 'm': numMinSplits = parseIntList(optarg, minSplits); break;
+    case 't': numThreads = atoi(optarg); break;
+    case 's': seed = (unsigned int) strtoul(optarg, NULL, 10); break;
+    case 'o': online = 1; break;
+    case 'b': memoryBudget = atol(optarg); break;
+    case 'i': infoFileName = optarg; break;
+    case 'u': deduplicate = 1; break;
+    case 'p': sparse = 1; break;
+    case 'w': saveFileName = optarg; break;
+    case 'l': loadFileName = optarg; break;
+    case 'O': optimize = 1; break;
+    case 'f': sampleFileName = optarg; optimize = 1; break;
+    case 'g': boostOptions.numRounds = atoi(optarg); break;
+    case 'r': boostOptions.learningRate = atof(optarg); break;
+    case 'q': quantize = 1; break;
+    case 'c': cacheDirectory = optarg; break;
+    case 'e': cacheBytes = atol(optarg); break;
+    case 'x': useCache = 0; break;
+    case 'n': maxLeaves = atoi(optarg); break;
+    case 'T': timeLimit = atof(optarg); break;
+    default:
+      printUsage(argv[0]);
+      return -1;
+    }
+  }
+
+  // LOADED MODEL
+  // The only file argument is the (optional) testing file
+  if (loadFileName) {
+    DTreeModel* model;
+    DTreeStatus status = dtreeLoad(loadFileName, &model);
+    if (status != DTREE_OK) {
+      printf("Model file '%s' couldn't be loaded: %s\n", loadFileName, dtreeStatusMessage(status));
+      return -1;
+    }
+    printf("Loaded a tree with %d nodes\n", dtreeNumNodes(model));
+
+    FILE* testFile = NULL;
+    if (argc - optind > 0) {
+      testFile = fopen(argv[optind], "r");
+      if (!testFile) {
+	printf("Testing file '%s' not found.\n", argv[optind]);
+	return -1;
+      }
+    }
+    return runLoadedModel(model, optimize, sampleFileName, testFile);
+  }
+
   //OPEN FILES
-  
-  if (argc < 2) {
+
+  if (argc - optind < 1) {
     printf("You must specify a training file.\n");
+    printUsage(argv[0]);
     return -1;
   }
-  
-  char const* const trainFileName = argv[1]; // Training data input file (MANDATORY)
-  
+
+  char const* const trainFileName = argv[optind]; // Training data input file (MANDATORY)
+
   FILE* trainFile = fopen(trainFileName, "r");
 
   if (!trainFile) {
     printf("Training file '%s' not found.\n", trainFileName);
     return -1;
   }
-  
+
   char* testFileName; // Testing data input file (OPTIONAL)
-  FILE* testFile;
-  if (argc > 2) {
-    testFileName = argv[2];
+  FILE* testFile = NULL;
+  if (argc - optind > 1) {
+    testFileName = argv[optind + 1];
     testFile = fopen(testFileName, "r");
     if (!testFile) {
       printf("Testing file '%s' not found.\n", testFileName);
       return -1;
     }
   }
-  
-  double d = 0; // Read numbers in file into here
 
-  FILE* stream; // Convert each line into a stream
-  
-  char line[BUFFER_SIZE]; // Read each line in file into here
-  int lineNumber = 1; // Keep track of the line we're on in the file
+  // SPARSE INPUT
+  // Trained with the first depth and minimum split size given
+  if (sparse) {
+    SparseNames* names = readSparseNames(trainFile, NULL);
+    fclose(trainFile);
+    if (!names) {
+      printf("Sparse input (-p) holds one target, but the training file's header gives more.\n");
+      return -1;
+    }
+    if (names->skippedTypes)
+      printf("Warning: -p treats every feature as ordered, so the types line is ignored.\n");
+    if (names->labels) {
+      // no header: the features and classes come from the instances
+      printf("Read %d features and %d classes; the classes stand for the labels", names->numFeatures, names->numClasses);
+      for (int c = 0; c < names->numClasses; c++)
+	printf(" %d", names->labels[c]);
+      printf("\n");
+    }
 
-  Names* names =(Names*)malloc(sizeof(Names)); // Where all the input data will be stored
-  names->numClasses = 0;
-  names->numFeatures = 0;
-  names->numInstances = 0;
+    TrainOptions options;
+    defaultTrainOptions(&options);
+    options.maxDepth = numDepths > 0 ? depths[0] : 0;
+    options.minSplit = numMinSplits > 0 ? minSplits[0] : 0;
 
-  InstanceListNode* instancesList = NULL;
+    DecisionTree* tree = makeSparseTree(names, &options);
+    printf("Read %d instances with %d nonzero values\n", names->numInstances, names->rowStart[names->numInstances]);
+    printf("\nTree:\n");
+    printTree(tree->root, 0);
+    printf("\nAccuracy of tree on training data: %lf\n", sparseAccuracy(tree, names));
 
-  // Read each line
-  while (fgets(line, sizeof(line), trainFile)) {
+    if (testFile) {
+      // the testing file's labels are read like the training file's, and its header (if any) is skipped
+      SparseNames* testNames = readSparseNames(testFile, names);
+      fclose(testFile);
+      if (testNames) {
+	printf("Accuracy of tree on testing data: %lf\n", sparseAccuracy(tree, testNames));
+	freeSparseNames(testNames);
+      } else {
+	printf("Sparse input (-p) holds one target, but the testing file's header gives more.\n");
+      }
+    }
 
-    stream = fmemopen(line, BUFFER_SIZE, "r"); // Convert to stream
-    int index = 0; // Keep track of number of numbers read in
+    freeSparseNames(names);
+    freeTree(tree->root);
+    free(tree);
+    return 0;
+  }
 
-    double temp[BUFFER_SIZE]; // Temporary array until we know the total size of the line
-    
-    // Read each number
-    while (fscanf(stream, "%lf,", &d)){
-      temp[index] = d;
-      index++;
+  // ONLINE LEARNING
+  // The training instances are never stored, only the tree and its leaf statistics
+  if (online) {
+    Names* names = (Names*)malloc(sizeof(Names));
+    names->numInstances = 0;
+    names->instances = NULL;
+    names->categorical = NULL;
+    names->numTargets = 1;
+    names->targets = NULL;
+    readHeader(trainFile, &(names->numClasses), &(names->numFeatures), &(names->numTargets));
+    if (names->numTargets > 1) {
+      printf("Online learning (-o) learns one target, but the training file's header gives %d.\n", names->numTargets);
+      fclose(trainFile);
+      freeNames(names);
+      return -1;
     }
 
-    // After the entire line is read
-    
-    if (lineNumber == 1){
-      // Classes & Features
-      names->numClasses = (int) temp[0];
-      names->numFeatures = (int) temp[1];
-      assert(names->numClasses > 0);
-      assert(names->numFeatures > 0);
-    } else {
-      // Instances
-      Instance* instance = (Instance*)malloc(sizeof(Instance)); // Make an instance
-      instance->featureValues = (double*)malloc(names->numFeatures * sizeof(double));
+    DecisionTree* tree = learnOnline(trainFile, names->numClasses, names->numFeatures, memoryBudget);
+    fclose(trainFile);
+    printf("\nTree:\n");
+    printTree(tree->root, 0);
 
-      for (int i = 0; i < names->numFeatures; i++) // Copy data
-	instance->featureValues[i] = temp[i];
+    testModel(treeClass, tree, names->numFeatures, names->numClasses, testFile);
+    freeNames(names);
+    freeTree(tree->root);
+    free(tree);
+    return 0;
+  }
 
-      instance->class = (int) temp[names->numFeatures];
-      assert(instance->class < names->numClasses && instance->class >= 0);
+  // Options of a single tree: the first depth and minimum split size given
+  DTreeOptions options;
+  dtreeDefaultOptions(&options);
+  options.maxDepth = numDepths > 0 ? depths[0] : 0;
+  options.minSplit = numMinSplits > 0 ? minSplits[0] : 0;
+  options.maxLeaves = maxLeaves;
+  options.memoryBudget = memoryBudget;
+  options.timeLimit = timeLimit;
 
-      push(&(instancesList), instance); // Add to front of linked list
-      names->numInstances++; // Keep track of number of instances
-    }
-
-    lineNumber++;
-    fclose(stream);
+  // MODEL CACHE
+  // With -c, a single tree trained on the same file contents with the same options is loaded instead of trained.
+  // Trees with a time limit depend on the machine's speed, so they aren't cached. The file is still read,
+  // so a hit prints the same report as a miss (the instances and the accuracy on them); only the training
+  // (and the lines saying how it went) are skipped.
+  CacheKey cacheKey = 0;
+  DTreeModel* cachedModel = NULL;
+  useCache = useCache && cacheDirectory && numFolds == 0 && boostOptions.numRounds == 0 && timeLimit <= 0;
+  if (useCache) {
+    _Bool ok;
+    cacheKey = trainingKey(trainFile, infoFileName, &options, &ok);
+    useCache = ok;
+  }
+  if (useCache && (cachedModel = cacheLoad(cacheDirectory, cacheKey)) != NULL) {
+    char path[BUFFER_SIZE];
+    cachePath(cacheDirectory, cacheKey, path, sizeof(path));
+    printf("Cache hit: loaded a tree with %d nodes from %s instead of training\n", dtreeNumNodes(cachedModel), path);
   }
-  
+
+  Names* names = readNames(trainFile); // Where all the input data is stored
   fclose(trainFile);
-  
-  // Linked list to array
-  names->instances = (Instance**)malloc(sizeof(Instance*) * names->numInstances);
-  InstanceListNode* current = instancesList;
-  int index = 0;
-  while (current) {
-    names->instances[index] = current->instance;
-    current = current->next;
-    index++;
-  }
-  freeList(instancesList);
-
-  
-  // Print back out the data to make sure we read it in correctly
-  printNames(names);
 
-  // Construct and test the tree
-  DecisionTree* tree = makeTree(names);
-  printf("\nTree:\n");
-  printTree(tree->root, 0);
-  printf("\nAccuracy of tree on training data: %lf\n", accuracy(tree, names->instances, names->numInstances));
-  
-  // TESTING DATA
-  if (argc > 2) {
-    printf("\nTESTING DATA:\n");
-    int numInstances = 0; // Keep track of number of instance
-    int countCorrect = 0; // Keep track of how many instances have been classified by the tree correctly
+  if (deduplicate && names->numTargets > 1) {
+    printf("Warning: -u is ignored with more than one target.\n");
+    deduplicate = 0;
+  } else if (deduplicate && (numFolds > 0 || boostOptions.numRounds > 0)) {
+    // (a single tree is deduplicated by the library)
+    int numRead = names->numInstances;
+    deduplicateNames(names);
+    printf("Folded %d instances into %d unique instances\n", numRead, names->numInstances);
+  }
 
-    // READ IN DATA
-    // Read each line
-    while (fgets(line, sizeof(line), testFile)) {
+  if (infoFileName) {
+    FILE* infoFile = fopen(infoFileName, "r");
+    if (!infoFile) {
+      printf("Info file '%s' not found.\n", infoFileName);
+      return -1;
+    }
+    if (!names->categorical)
+      names->categorical = (_Bool*)calloc(names->numFeatures, sizeof(_Bool));
+    int numDescribed = readFeatureTypes(infoFile, names->categorical, names->numFeatures);
+    fclose(infoFile);
+    if (numDescribed != names->numFeatures)
+      printf("Warning: info file describes %d features, the training file has %d.\n", numDescribed, names->numFeatures);
+  }
+
+  // Categorical features must hold integer codes, whether the types line or the info file marked them
+  int invalidInstance;
+  int invalidFeature = findInvalidCode(names, &invalidInstance);
+  if (invalidFeature >= 0) {
+    printf("Feature %d is categorical, but an instance has the value %lf, which isn't an integer code of at most %.0lf.\n",
+	   invalidFeature, names->instances[invalidInstance]->featureValues[invalidFeature], MAX_CODE);
+    freeNames(names);
+    return -1;
+  }
 
-      stream = fmemopen(line, BUFFER_SIZE, "r"); // Convert to stream
-      int index = 0; // Keep track of number of numbers read in
-      double temp[BUFFER_SIZE]; // Temporary array to read data into
-      
-      // Read each number
-      while (fscanf(stream, "%lf,", &d)){
-	temp[index] = d;
-	index++;
+  // CROSS-VALIDATION
+  // Every combination of the listed depths and minimum split sizes is evaluated on the same folds
+  if (numFolds > 0) {
+    if (numFolds < 2 || numFolds > names->numInstances || numDepths == 0 || numMinSplits == 0) {
+      printf("Cross-validation needs 2 <= folds <= %d and at least one depth and minimum split size.\n", names->numInstances);
+      return -1;
+    }
+
+    int numConfigs = numDepths * numMinSplits;
+    TrainOptions* configs = (TrainOptions*)malloc(sizeof(TrainOptions) * numConfigs);
+    CrossValidationResult* results = (CrossValidationResult*)malloc(sizeof(CrossValidationResult) * numConfigs);
+    for (int i = 0; i < numDepths; i++)
+      for (int j = 0; j < numMinSplits; j++) {
+	defaultTrainOptions(&configs[i * numMinSplits + j]);
+	configs[i * numMinSplits + j].maxDepth = depths[i];
+	configs[i * numMinSplits + j].minSplit = minSplits[j];
+	configs[i * numMinSplits + j].maxLeaves = maxLeaves;
+	configs[i * numMinSplits + j].memoryBudget = memoryBudget;
+	configs[i * numMinSplits + j].timeLimit = timeLimit;
       }
 
-      // Create an instance
-      Instance* instance = (Instance*)malloc(sizeof(Instance)); // Make an instance
-      instance->featureValues = (double*)malloc(names->numFeatures * sizeof(double));
+    _Bool ok = crossValidate(names, numFolds, configs, numConfigs, numThreads, seed, results);
+    if (ok)
+      printCrossValidationResults(results, numConfigs, numFolds);
+    else
+      printf("Cross-validation failed: %s\n", dtreeStatusMessage(DTREE_ERROR_MEMORY));
 
-      for (int i = 0; i < names->numFeatures; i++) // Copy data
-	instance->featureValues[i] = temp[i];
+    free(configs);
+    free(results);
+    if (testFile)
+      fclose(testFile);
+    freeNames(names);
+    return ok ? 0 : -1;
+  }
 
-      instance->class = (int) temp[names->numFeatures];
-      assert(instance->class < names->numClasses && instance->class >= 0);
+  // BOOSTING
+  // Trained on the first target, with the first depth given (if it isn't 0)
+  if (boostOptions.numRounds > 0) {
+    if (names->numTargets > 1)
+      printf("Warning: -g trains on the first target only.\n");
+    if (numDepths > 0 && depths[0] > 0)
+      boostOptions.maxDepth = depths[0];
+    boostOptions.numThreads = numThreads;
+    _Bool ok = learnBoosted(names, &boostOptions, testFile);
+    if (!ok)
+      printf("Boosting failed: %s\n", dtreeStatusMessage(DTREE_ERROR_MEMORY));
+    freeNames(names);
+    return ok ? 0 : -1;
+  }
 
-      // Test it
-      printInstance(instance, names->numFeatures);
-      int treeClass = classify(tree, instance);
-      printf("\nTree classifies as %d\n\n", treeClass);
-      if (treeClass == instance->class)
-	countCorrect++;
-      numInstances++;
+  // MULTIPLE TARGETS
+  // The header's third number gives the number of class columns; one tree is grown for each with the options above
+  if (names->numTargets > 1) {
+    TrainOptions targetOptions;
+    defaultTrainOptions(&targetOptions);
+    targetOptions.maxDepth = options.maxDepth;
+    targetOptions.minSplit = options.minSplit;
+    targetOptions.maxLeaves = options.maxLeaves;
+    targetOptions.memoryBudget = options.memoryBudget;
+    targetOptions.timeLimit = options.timeLimit;
+    _Bool ok = learnEachTarget(names, &targetOptions, testFile);
+    if (!ok)
+      printf("Training failed: %s\n", dtreeStatusMessage(DTREE_ERROR_MEMORY));
+    freeNames(names);
+    return ok ? 0 : -1;
+  }
 
-      // Free it
-      freeInstance(instance);
-      fclose(stream);
+  // Print back out the data to make sure we read it in correctly
+  printNames(names);
+
+  // Rows to optimize the tree's layout for
+  double* sample = NULL;
+  int numSample = 0;
+  if (sampleFileName) {
+    FILE* sampleFile = fopen(sampleFileName, "r");
+    if (!sampleFile) {
+      printf("Sample file '%s' not found.\n", sampleFileName);
+      return -1;
     }
+    sample = readSample(sampleFile, names->numFeatures, names->numClasses, &numSample);
+    fclose(sampleFile);
+  }
 
-    printf("Accuracy of tree on testing data: %f\n", (double) countCorrect / (double) numInstances);
-    fclose(testFile);
+  // Construct and test the tree through the library (unless the cache had it)
+  DTreeModel* model = cachedModel;
+  if (!model) {
+    model = trainModel(names, &options, deduplicate);
+    if (model && useCache && !cacheStore(cacheDirectory, cacheKey, model, cacheBytes))
+      printf("Warning: the tree couldn't be stored in the cache directory '%s'.\n", cacheDirectory);
+  }
+  if (model)
+    reportModel(model, names, optimize, quantize, sample, numSample);
+  freeNames(names);
+  free(sample);
+  if (!model)
+    return -1;
+
+  if (saveFileName) {
+    DTreeStatus status = dtreeSave(model, saveFileName);
+    if (status != DTREE_OK)
+      printf("Model file '%s' couldn't be saved: %s\n", saveFileName, dtreeStatusMessage(status));
   }
-  
+
+  testModel(modelClass, model, dtreeNumFeatures(model), dtreeNumClasses(model), testFile);
+
   // Memory cleanup
-  freeArrayAndInstances(names->instances, names->numInstances);
-  free(names);
-  freeTree(tree->root);
-  free(tree);
-
-  // Close streams
-  //fclose(stream);
-  // fclose(trainFile);
-  
+  dtreeModelFree(model);
+
   return 0;
 }
-  
@@ -0,0 +1,654 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "sparse.h"
+#include "decision_tree.h"
+#include "presort.h"
+#include "input.h"
+
+// Sparse Names
+
+// A nonzero entry, used to sort a row by feature or a column by value
+typedef struct Entry {
+  int index;
+  double value;
+} Entry;
+
+// qsort comparator: ascending by index
+static int compareIndex(const void* a, const void* b) {
+  return ((const Entry*) a)->index - ((const Entry*) b)->index;
+}
+
+// qsort comparator: ascending by value, then by index
+static int compareValue(const void* a, const void* b) {
+  const Entry* x = (const Entry*) a;
+  const Entry* y = (const Entry*) b;
+  if (x->value < y->value) return -1;
+  if (x->value > y->value) return 1;
+  return x->index - y->index;
+}
+
+// Builds the columns (CSC) from the rows (CSR), sorting each column by value
+static void buildColumns(SparseNames* names) {
+  int numEntries = names->rowStart[names->numInstances];
+  names->columnStart = (int*)calloc(names->numFeatures + 1, sizeof(int));
+  names->columnRows = (int*)malloc(sizeof(int) * numEntries);
+  names->columnValues = (double*)malloc(sizeof(double) * numEntries);
+
+  // count the entries of each column
+  for (int e = 0; e < numEntries; e++)
+    names->columnStart[names->indices[e] + 1]++;
+  for (int f = 0; f < names->numFeatures; f++)
+    names->columnStart[f + 1] += names->columnStart[f];
+
+  // place them, then sort each column
+  int* next = (int*)malloc(sizeof(int) * names->numFeatures);
+  memcpy(next, names->columnStart, sizeof(int) * names->numFeatures);
+  Entry* entries = (Entry*)malloc(sizeof(Entry) * (numEntries > 0 ? numEntries : 1));
+  for (int i = 0; i < names->numInstances; i++)
+    for (int e = names->rowStart[i]; e < names->rowStart[i + 1]; e++) {
+      entries[next[names->indices[e]]].index = i;
+      entries[next[names->indices[e]]].value = names->values[e];
+      next[names->indices[e]]++;
+    }
+
+  for (int f = 0; f < names->numFeatures; f++) {
+    int start = names->columnStart[f];
+    qsort(entries + start, names->columnStart[f + 1] - start, sizeof(Entry), compareValue);
+  }
+
+  for (int e = 0; e < numEntries; e++) {
+    names->columnRows[e] = entries[e].index;
+    names->columnValues[e] = entries[e].value;
+  }
+
+  free(next);
+  free(entries);
+}
+
+// qsort comparator: ascending ints
+static int compareLabel(const void* a, const void* b) {
+  int x = *(const int*) a;
+  int y = *(const int*) b;
+  return (x > y) - (x < y);
+}
+
+// Returns the class of a label: its index in the increasing labels (the label itself if labels is
+// NULL), or -1 if no class has it
+static int classOfLabel(int label, int* labels, int numClasses) {
+  if (!labels)
+    return label >= 0 && label < numClasses ? label : -1;
+  int lo = 0;
+  int hi = numClasses;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (labels[mid] < label)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < numClasses && labels[lo] == label ? lo : -1;
+}
+
+// Reads a sparse file into rows and columns
+// Every instance is one line in libsvm style: the class label followed by "feature:value" pairs,
+// e.g. "1 0:2.5 7:1 12:-3". Missing features are 0, and features keep the numbers the file gives
+// them, so 0-based and 1-based files both work. A training file may start with the dense format's
+// first line (number of classes, number of features), and then its labels are the classes 0 to
+// numClasses-1. Without it, as in libsvm files, there is one feature more than the highest feature
+// number and the distinct labels, in increasing order, become the classes (see labels).
+// training is NULL for a training file. For a testing file it is the names the tree was trained on:
+// the labels are mapped to classes the same way (-1 for labels no class has) and a first line is skipped.
+// Returns NULL if the first line gives more than one target, which the sparse format can't hold
+SparseNames* readSparseNames(FILE* file, SparseNames* training) {
+  assert(file != NULL);
+  SparseNames* names = (SparseNames*)malloc(sizeof(SparseNames));
+  names->numInstances = 0;
+  names->numClasses = 0;
+  names->numFeatures = 0;
+  names->labels = NULL;
+  names->columnStart = NULL;
+  names->columnRows = NULL;
+  names->columnValues = NULL;
+
+  int capacityInstances = 64;
+  int capacityEntries = 256;
+  int numEntries = 0;
+  names->classes = (int*)malloc(sizeof(int) * capacityInstances);
+  names->rowStart = (int*)malloc(sizeof(int) * (capacityInstances + 1));
+  names->indices = (int*)malloc(sizeof(int) * capacityEntries);
+  names->values = (double*)malloc(sizeof(double) * capacityEntries);
+  names->rowStart[0] = 0;
+
+  char* line = NULL; // Rows can be arbitrarily long, so getline allocates the buffer
+  size_t lineSize = 0;
+  int capacityRow = 0;
+  Entry* row = NULL; // Sort buffer for rows given out of feature order, reused across rows
+  _Bool firstLine = 1;
+  _Bool hasHeader = 0;
+  int maxIndex = 0;
+  names->skippedTypes = 0;
+  while (getline(&line, &lineSize, file) != -1) {
+    // the header has no "feature:value" pairs, while an instance line without any has one number
+    if (firstLine) {
+      firstLine = 0;
+      int numClasses, numFeatures, numTargets;
+      if (!strchr(line, ':') && parseHeader(line, &numClasses, &numFeatures, &numTargets)) {
+	if (numTargets != 1) {
+	  free(line);
+	  freeSparseNames(names);
+	  return NULL;
+	}
+	if (!training) {
+	  assert(numClasses > 0);
+	  assert(numFeatures > 0);
+	  names->numClasses = numClasses;
+	  names->numFeatures = numFeatures;
+	}
+	hasHeader = 1;
+	continue;
+      }
+    }
+    if (names->numInstances == 0 && isTypesLine(line)) {
+      names->skippedTypes = 1;
+      continue;
+    }
+
+    char* text = line;
+    char* end;
+    double label = strtod(text, &end);
+    if (end == text)
+      continue; // Blank line
+    assert(label == (int) label);
+    int class = (int) label;
+    assert(training || !hasHeader || (class >= 0 && class < names->numClasses));
+    text = end;
+
+    if (names->numInstances == capacityInstances) {
+      capacityInstances *= 2;
+      names->classes = (int*)realloc(names->classes, sizeof(int) * capacityInstances);
+      names->rowStart = (int*)realloc(names->rowStart, sizeof(int) * (capacityInstances + 1));
+    }
+
+    // feature:value pairs
+    int rowStart = numEntries;
+    while (1) {
+      int index = (int) strtol(text, &end, 10);
+      if (end == text || *end != ':')
+	break;
+      text = end + 1;
+      double value = strtod(text, &end);
+      assert(end != text);
+      text = end;
+      assert(index >= 0);
+      assert(training || !hasHeader || index < names->numFeatures);
+
+      if (value == 0)
+	continue; // Zeros are implicit
+
+      if (numEntries == capacityEntries) {
+	capacityEntries *= 2;
+	names->indices = (int*)realloc(names->indices, sizeof(int) * capacityEntries);
+	names->values = (double*)realloc(names->values, sizeof(double) * capacityEntries);
+      }
+      names->indices[numEntries] = index;
+      names->values[numEntries] = value;
+      numEntries++;
+      if (index > maxIndex)
+	maxIndex = index;
+    }
+    // keep the row sorted by feature, so values can be looked up by binary search
+    _Bool isSorted = 1;
+    for (int e = rowStart + 1; e < numEntries; e++)
+      if (names->indices[e] <= names->indices[e - 1])
+	isSorted = 0;
+    if (!isSorted) {
+      int numRow = numEntries - rowStart;
+      if (numRow > capacityRow) {
+	capacityRow = numRow;
+	free(row);
+	row = (Entry*)malloc(sizeof(Entry) * capacityRow);
+      }
+      for (int e = 0; e < numRow; e++) {
+	row[e].index = names->indices[rowStart + e];
+	row[e].value = names->values[rowStart + e];
+      }
+      qsort(row, numRow, sizeof(Entry), compareIndex);
+      for (int e = 0; e < numRow; e++) {
+	assert(e == 0 || row[e].index != row[e - 1].index);
+	names->indices[rowStart + e] = row[e].index;
+	names->values[rowStart + e] = row[e].value;
+      }
+    }
+
+    names->classes[names->numInstances] = class;
+    names->numInstances++;
+    names->rowStart[names->numInstances] = numEntries;
+  }
+  free(line);
+  free(row);
+
+  // map the labels to classes
+  if (training) {
+    names->numClasses = training->numClasses;
+    for (int i = 0; i < names->numInstances; i++)
+      names->classes[i] = classOfLabel(names->classes[i], training->labels, training->numClasses);
+  } else if (!hasHeader) {
+    int* labels = (int*)malloc(sizeof(int) * (names->numInstances > 0 ? names->numInstances : 1));
+    memcpy(labels, names->classes, sizeof(int) * names->numInstances);
+    qsort(labels, names->numInstances, sizeof(int), compareLabel);
+    int numLabels = 0;
+    for (int i = 0; i < names->numInstances; i++)
+      if (numLabels == 0 || labels[i] != labels[numLabels - 1])
+	labels[numLabels++] = labels[i];
+    names->labels = (int*)realloc(labels, sizeof(int) * (numLabels > 0 ? numLabels : 1));
+    names->numClasses = numLabels;
+    for (int i = 0; i < names->numInstances; i++)
+      names->classes[i] = classOfLabel(names->classes[i], names->labels, numLabels);
+  }
+  if (training || !hasHeader)
+    names->numFeatures = maxIndex + 1;
+
+  buildColumns(names);
+  return names;
+}
+
+// Frees the rows, the columns and the structure itself
+void freeSparseNames(SparseNames* names) {
+  free(names->classes);
+  free(names->labels);
+  free(names->rowStart);
+  free(names->indices);
+  free(names->values);
+  free(names->columnStart);
+  free(names->columnRows);
+  free(names->columnValues);
+  free(names);
+}
+
+
+
+// Tree
+
+// A leaf of the level being grown, and the best split found for it so far
+typedef struct OpenNode {
+  DecisionTreeNode* node;
+  int depth;
+  int numInstances;
+  _Bool canSplit; // Neither pure nor stopped by the options
+
+  int feature;    // Best split so far (-1 for none)
+  double split;
+  double entropy;
+} OpenNode;
+
+// The nonzero entries of the rows that are still in open nodes, by column
+// Starts as a copy of the input's columns and drops the rows of finished leaves now and then
+typedef struct Columns {
+  int* start;
+  int* rows;
+  double* values;
+  int numRows; // Rows left after the last compaction
+} Columns;
+
+// State of the split search over one feature
+typedef struct Search {
+  int numClasses;
+  OpenNode* open;
+  int* classCount;   // classCount[k * numClasses + c] for open node k
+  int* nonzeroCount; // Class counts of the node's rows with a nonzero value
+  int* numNonzero;
+  int* leftCount;    // Class counts at or below the node's last value
+  int* numLeft;
+  double* lastValue; // Last value seen by the node in the sweep
+  _Bool* pending;    // The node has a last value whose split hasn't been evaluated
+  int* touched;      // Nodes with a nonzero entry in the feature, the only ones it can split
+  int numTouched;
+} Search;
+
+// Returns the value of the feature in a sparse row (0 if it isn't listed)
+static double sparseValue(int* indices, double* values, int numValues, int feature) {
+  int lo = 0;
+  int hi = numValues;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (indices[mid] < feature)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < numValues && indices[lo] == feature ? values[lo] : 0.0;
+}
+
+// Returns the entropy of n instances with the given class counts
+static double classEntropy(int* classCount, int n, int numClasses) {
+  double info = 0.0;
+  for (int i = 0; i < numClasses; i++) {
+    if (classCount[i] != 0) {
+      double d = ((double) classCount[i]) / ((double) n);
+      info += -d * log2(d);
+    }
+  }
+  return info;
+}
+
+// Evaluates splitting node k at the threshold with the current left counts
+// Features are searched in increasing order and thresholds in increasing order within a feature,
+// so on ties the lower feature, then the lower threshold, wins
+static void evaluate(Search* s, int k, int feature, double threshold) {
+  int numClasses = s->numClasses;
+  OpenNode* open = &s->open[k];
+  int numLeft = s->numLeft[k];
+  int numRight = open->numInstances - numLeft;
+  if (numLeft == 0 || numRight == 0)
+    return;
+
+  int* leftCount = s->leftCount + k * numClasses;
+  int* classCount = s->classCount + k * numClasses;
+  int rightCount[numClasses];
+  for (int i = 0; i < numClasses; i++)
+    rightCount[i] = classCount[i] - leftCount[i];
+
+  double entropy = (((double) numLeft) / open->numInstances) * classEntropy(leftCount, numLeft, numClasses)
+    + (((double) numRight) / open->numInstances) * classEntropy(rightCount, numRight, numClasses);
+
+  if (open->feature == -1 || entropy < open->entropy) {
+    open->feature = feature;
+    open->split = threshold;
+    open->entropy = entropy;
+  }
+}
+
+// Adds the entry of node k with the value to the left side of the sweep,
+// first evaluating the split after the node's previous value if this one is larger
+static void sweep(Search* s, int k, int feature, double value, int class) {
+  if (s->pending[k] && value != s->lastValue[k])
+    evaluate(s, k, feature, s->lastValue[k]);
+  s->leftCount[k * s->numClasses + class]++;
+  s->numLeft[k]++;
+  s->lastValue[k] = value;
+  s->pending[k] = 1;
+}
+
+// Finds the best split of every open node on one feature
+// Only the feature's nonzero entries are visited. They are sorted by value, so one sweep moves
+// each node's threshold upwards; the rows of a node that are 0 form one bucket between the negative
+// and the positive entries, and its class counts are the node's counts minus its nonzero counts.
+// Nodes without a nonzero entry are all zeros and can't split, so the work is proportional to the entries.
+static void searchFeature(Search* s, SparseNames* names, Columns* columns, int* nodeOf, int feature) {
+  int numClasses = s->numClasses;
+  int start = columns->start[feature];
+  int end = columns->start[feature + 1];
+
+  // nonzero counts of each node (the counts are all 0 between features)
+  s->numTouched = 0;
+  for (int e = start; e < end; e++) {
+    int row = columns->rows[e];
+    int k = nodeOf[row];
+    if (k >= 0 && s->open[k].canSplit) {
+      if (s->numNonzero[k] == 0) {
+	s->touched[s->numTouched] = k;
+	s->numTouched++;
+      }
+      s->nonzeroCount[k * numClasses + names->classes[row]]++;
+      s->numNonzero[k]++;
+    }
+  }
+
+  for (int t = 0; t < s->numTouched; t++) {
+    int k = s->touched[t];
+    memset(s->leftCount + k * numClasses, 0, sizeof(int) * numClasses);
+    s->numLeft[k] = 0;
+    s->pending[k] = 0;
+  }
+
+  // negative values
+  int e = start;
+  for (; e < end && columns->values[e] < 0; e++) {
+    int row = columns->rows[e];
+    int k = nodeOf[row];
+    if (k >= 0 && s->open[k].canSplit)
+      sweep(s, k, feature, columns->values[e], names->classes[row]);
+  }
+
+  // the zero bucket
+  for (int t = 0; t < s->numTouched; t++) {
+    int k = s->touched[t];
+    int numZero = s->open[k].numInstances - s->numNonzero[k];
+    if (numZero == 0)
+      continue;
+    if (s->pending[k])
+      evaluate(s, k, feature, s->lastValue[k]);
+    for (int i = 0; i < numClasses; i++)
+      s->leftCount[k * numClasses + i] += s->classCount[k * numClasses + i] - s->nonzeroCount[k * numClasses + i];
+    s->numLeft[k] += numZero;
+    s->lastValue[k] = 0.0;
+    s->pending[k] = 1;
+  }
+
+  // positive values
+  for (; e < end; e++) {
+    int row = columns->rows[e];
+    int k = nodeOf[row];
+    if (k >= 0 && s->open[k].canSplit)
+      sweep(s, k, feature, columns->values[e], names->classes[row]);
+  }
+
+  // the split after each node's largest value, and reset the counts for the next feature
+  for (int t = 0; t < s->numTouched; t++) {
+    int k = s->touched[t];
+    if (s->pending[k])
+      evaluate(s, k, feature, s->lastValue[k]);
+    memset(s->nonzeroCount + k * numClasses, 0, sizeof(int) * numClasses);
+    s->numNonzero[k] = 0;
+  }
+}
+
+// Drops the entries of rows in finished leaves from the columns, keeping each column's order
+static void compactColumns(Columns* columns, int* nodeOf, int numFeatures, int numRows) {
+  int numKept = 0;
+  int from = columns->start[0];
+  for (int f = 0; f < numFeatures; f++) {
+    int to = columns->start[f + 1];
+    columns->start[f] = numKept;
+    for (int e = from; e < to; e++)
+      if (nodeOf[columns->rows[e]] >= 0) {
+	columns->rows[numKept] = columns->rows[e];
+	columns->values[numKept] = columns->values[e];
+	numKept++;
+      }
+    from = to;
+  }
+  columns->start[numFeatures] = numKept;
+  columns->numRows = numRows;
+}
+
+// Returns a new leaf node (its class is set once its instances have been counted)
+static DecisionTreeNode* makeOpenLeaf(void) {
+  DecisionTreeNode* node = (DecisionTreeNode*)malloc(sizeof(DecisionTreeNode));
+  node->isLeaf = 1;
+  node->isCategorical = 0;
+  node->info.class = 0;
+  return node;
+}
+
+// Constructs a tree on sparse input data and returns a pointer to it
+// The tree is grown one level at a time: each level costs one pass over the nonzero entries of
+// every feature plus one pass over the rows, however many nodes the level has. Rows that reach a
+// finished leaf drop out of both passes (from the columns once a quarter of the rows have left).
+// Like learn, nodes stop at one class or when no split separates their instances.
+DecisionTree* makeSparseTree(SparseNames* names, TrainOptions* options) {
+  assert(names != NULL);
+  assert(options != NULL);
+  assert(names->numInstances > 0);
+  int numClasses = names->numClasses;
+  int numInstances = names->numInstances;
+
+  DecisionTree* tree = (DecisionTree*)malloc(sizeof(DecisionTree));
+  tree->root = makeOpenLeaf();
+
+  int* nodeOf = (int*)calloc(numInstances, sizeof(int)); // Open node of each row, -1 once in a finished leaf
+  int* activeRows = (int*)malloc(sizeof(int) * numInstances); // Rows in open nodes
+  int numActive = numInstances;
+  for (int i = 0; i < numInstances; i++)
+    activeRows[i] = i;
+
+  int numEntries = names->columnStart[names->numFeatures];
+  Columns columns;
+  columns.start = (int*)malloc(sizeof(int) * (names->numFeatures + 1));
+  columns.rows = (int*)malloc(sizeof(int) * (numEntries > 0 ? numEntries : 1));
+  columns.values = (double*)malloc(sizeof(double) * (numEntries > 0 ? numEntries : 1));
+  columns.numRows = numInstances;
+  memcpy(columns.start, names->columnStart, sizeof(int) * (names->numFeatures + 1));
+  memcpy(columns.rows, names->columnRows, sizeof(int) * numEntries);
+  memcpy(columns.values, names->columnValues, sizeof(double) * numEntries);
+  int numOpen = 1;
+  OpenNode* open = (OpenNode*)malloc(sizeof(OpenNode));
+  open[0].node = tree->root;
+  open[0].depth = 0;
+
+  while (numOpen > 0) {
+    Search s;
+    s.numClasses = numClasses;
+    s.open = open;
+    s.classCount = (int*)calloc(numOpen * numClasses, sizeof(int));
+    s.nonzeroCount = (int*)calloc(numOpen * numClasses, sizeof(int));
+    s.numNonzero = (int*)calloc(numOpen, sizeof(int));
+    s.touched = (int*)malloc(sizeof(int) * numOpen);
+    s.leftCount = (int*)malloc(sizeof(int) * numOpen * numClasses);
+    s.numLeft = (int*)malloc(sizeof(int) * numOpen);
+    s.lastValue = (double*)malloc(sizeof(double) * numOpen);
+    s.pending = (_Bool*)malloc(sizeof(_Bool) * numOpen);
+
+    // count classes
+    for (int k = 0; k < numOpen; k++)
+      open[k].numInstances = 0;
+    for (int a = 0; a < numActive; a++) {
+      int i = activeRows[a];
+      s.classCount[nodeOf[i] * numClasses + names->classes[i]]++;
+      open[nodeOf[i]].numInstances++;
+    }
+
+    // every open node is a leaf of its majority class until it splits
+    for (int k = 0; k < numOpen; k++) {
+      int* classCount = s.classCount + k * numClasses;
+      int majClass = 0;
+      int numPresent = 0;
+      for (int i = 0; i < numClasses; i++) {
+	if (classCount[i] > classCount[majClass])
+	  majClass = i;
+	if (classCount[i] > 0)
+	  numPresent++;
+      }
+      open[k].node->info.class = majClass;
+      open[k].feature = -1;
+      open[k].canSplit = numPresent > 1
+	&& !(options->maxDepth > 0 && open[k].depth >= options->maxDepth)
+	&& open[k].numInstances >= options->minSplit;
+    }
+
+    for (int f = 0; f < names->numFeatures; f++)
+      searchFeature(&s, names, &columns, nodeOf, f);
+
+    // split the nodes that found a split; their children form the next level
+    int numNext = 0;
+    int* firstChild = (int*)malloc(sizeof(int) * numOpen);
+    for (int k = 0; k < numOpen; k++) {
+      firstChild[k] = -1;
+      if (open[k].canSplit && open[k].feature != -1) {
+	firstChild[k] = numNext;
+	numNext += 2;
+      }
+    }
+
+    OpenNode* next = (OpenNode*)malloc(sizeof(OpenNode) * (numNext > 0 ? numNext : 1));
+    for (int k = 0; k < numOpen; k++) {
+      if (firstChild[k] == -1)
+	continue;
+      DecisionTreeNode* node = open[k].node;
+      next[firstChild[k]].node = makeOpenLeaf();
+      next[firstChild[k]].depth = open[k].depth + 1;
+      next[firstChild[k] + 1].node = makeOpenLeaf();
+      next[firstChild[k] + 1].depth = open[k].depth + 1;
+
+      node->isLeaf = 0;
+      node->info.decision.feature = open[k].feature;
+      node->info.decision.split = open[k].split;
+      node->info.decision.left = next[firstChild[k]].node;
+      node->info.decision.right = next[firstChild[k] + 1].node;
+    }
+
+    // move each row to its child
+    int numStillActive = 0;
+    for (int a = 0; a < numActive; a++) {
+      int i = activeRows[a];
+      int k = nodeOf[i];
+      if (firstChild[k] == -1) {
+	nodeOf[i] = -1;
+	continue;
+      }
+      double value = sparseValue(names->indices + names->rowStart[i], names->values + names->rowStart[i],
+				 names->rowStart[i + 1] - names->rowStart[i], open[k].feature);
+      nodeOf[i] = firstChild[k] + (value <= open[k].split ? 0 : 1);
+      activeRows[numStillActive] = i;
+      numStillActive++;
+    }
+    numActive = numStillActive;
+    if (numActive < columns.numRows - columns.numRows / 4)
+      compactColumns(&columns, nodeOf, names->numFeatures, numActive);
+
+    free(s.classCount);
+    free(s.nonzeroCount);
+    free(s.numNonzero);
+    free(s.leftCount);
+    free(s.numLeft);
+    free(s.lastValue);
+    free(s.pending);
+    free(s.touched);
+    free(firstChild);
+    free(open);
+    open = next;
+    numOpen = numNext;
+  }
+
+  free(open);
+  free(nodeOf);
+  free(activeRows);
+  free(columns.start);
+  free(columns.rows);
+  free(columns.values);
+  return tree;
+}
+
+// Returns the class that the tree gives for a sparse row
+// indices lists the row's features in increasing order and values their (nonzero) values
+int classifySparse(DecisionTree* tree, int* indices, double* values, int numValues) {
+  assert(tree != NULL);
+  DecisionTreeNode* current = tree->root;
+
+  // While the current node isn't a leaf node
+  while (!(current->isLeaf)) {
+    int feature = current->isCategorical ? current->info.category.feature : current->info.decision.feature;
+    current = childNode(current, sparseValue(indices, values, numValues, feature));
+  }
+
+  // Return the leaf node's class
+  return current->info.class;
+}
+
+// Returns the ratio of correct classifications to the number of instances
+double sparseAccuracy(DecisionTree* tree, SparseNames* names) {
+  assert(tree != NULL);
+  assert(names->numInstances > 0);
+  int countCorrect = 0;
+
+  for (int i = 0; i < names->numInstances; i++) {
+    int start = names->rowStart[i];
+    if (classifySparse(tree, names->indices + start, names->values + start, names->rowStart[i + 1] - start) == names->classes[i])
+      countCorrect++;
+  }
+
+  return (double) countCorrect / (double) names->numInstances;
+}
@@ -0,0 +1,36 @@
+#ifndef SPARSE_H_
+#define SPARSE_H_
+
+#include <stdio.h>
+#include "decision_tree.h"
+#include "presort.h"
+
+// Sparse Names
+typedef struct SparseNames { // Input data where features missing from a row are 0
+  int numClasses;
+  int numFeatures;
+  int numInstances;
+  int* classes; // classes[i] is the class of instance i
+  int* labels;  // labels[c] is the file's label of class c, NULL if the file's labels are the classes
+  _Bool skippedTypes; // The file had a types line, which is skipped: sparse trees treat every feature as ordered
+
+  // Rows (CSR): the nonzeros of instance i are entries rowStart[i] to rowStart[i+1]-1
+  int* rowStart;
+  int* indices;   // Feature of each entry, increasing within a row
+  double* values; // Value of each entry
+
+  // Columns (CSC): the nonzeros of feature f are entries columnStart[f] to columnStart[f+1]-1
+  int* columnStart;
+  int* columnRows;      // Instance of each entry
+  double* columnValues; // Value of each entry, increasing within a column
+} SparseNames;
+
+SparseNames* readSparseNames(FILE* file, SparseNames* training);
+void freeSparseNames(SparseNames* names);
+
+// Tree
+DecisionTree* makeSparseTree(SparseNames* names, TrainOptions* options);
+int classifySparse(DecisionTree* tree, int* indices, double* values, int numValues);
+double sparseAccuracy(DecisionTree* tree, SparseNames* names);
+
+#endif
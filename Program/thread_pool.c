@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+// Workers sleep on start until the generation changes, take tasks of the batch until none are left,
+// and the last one to finish signals done
+struct ThreadPool {
+  pthread_t* threads;
+  int numStarted; // Worker threads; the thread calling poolRun works as one more
+
+  TaskFunction function;
+  void* context;
+  int numTasks;
+  int nextTask;    // The next task of the batch to hand out
+  int numWorking;  // Workers that haven't finished the batch yet
+  long generation; // Incremented for every batch
+  _Bool stop;
+
+  pthread_mutex_t lock; // Guards everything from function on
+  pthread_cond_t start;
+  pthread_cond_t done;
+};
+
+// Returns the number of online processors (at least 1)
+int defaultNumThreads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+}
+
+// Keeps taking the next unstarted task of the current batch until there are none left
+static void takeTasks(ThreadPool* pool) {
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    int task = pool->nextTask;
+    pool->nextTask++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (task >= pool->numTasks)
+      return;
+
+    pool->function(pool->context, task);
+  }
+}
+
+// Worker loop: wait for a new batch (or the pool to stop), work on it, report it done
+static void* worker(void* arg) {
+  ThreadPool* pool = (ThreadPool*) arg;
+  long seen = 0;
+
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->generation == seen && !pool->stop)
+      pthread_cond_wait(&pool->start, &pool->lock);
+    if (pool->stop) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+
+    takeTasks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->numWorking--;
+    if (pool->numWorking == 0)
+      pthread_cond_signal(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+// Starts numThreads - 1 workers, which wait for poolRun; the thread calling poolRun is the last one.
+// numThreads <= 0 uses one thread per processor. Fewer workers start if the system refuses some.
+ThreadPool* makeThreadPool(int numThreads) {
+  if (numThreads <= 0)
+    numThreads = defaultNumThreads();
+
+  ThreadPool* pool = (ThreadPool*)malloc(sizeof(ThreadPool));
+  pool->threads = (pthread_t*)malloc(sizeof(pthread_t) * numThreads);
+  pool->numStarted = 0;
+  pool->numTasks = 0;
+  pool->nextTask = 0;
+  pool->numWorking = 0;
+  pool->generation = 0;
+  pool->stop = 0;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  for (int i = 1; i < numThreads; i++)
+    if (pthread_create(&pool->threads[pool->numStarted], NULL, worker, pool) == 0)
+      pool->numStarted++;
+  return pool;
+}
+
+// Runs function(context, task) for every task in [0, numTasks) on the pool's threads and returns
+// once all tasks have finished. Tasks are handed out in increasing order. Only one thread may call
+// this on a pool at a time.
+void poolRun(ThreadPool* pool, TaskFunction function, void* context, int numTasks) {
+  assert(pool != NULL);
+  assert(function != NULL);
+  if (numTasks <= 0)
+    return;
+  if (pool->numStarted == 0 || numTasks == 1) {
+    for (int task = 0; task < numTasks; task++)
+      function(context, task);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->function = function;
+  pool->context = context;
+  pool->numTasks = numTasks;
+  pool->nextTask = 0;
+  pool->numWorking = pool->numStarted;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  takeTasks(pool);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->numWorking > 0)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// Stops and joins the workers
+void freeThreadPool(ThreadPool* pool) {
+  if (pool == NULL)
+    return;
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 0; i < pool->numStarted; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->start);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+// Runs function(context, task) for every task in [0, numTasks) on up to numThreads threads
+// and returns once all tasks have finished. numThreads <= 0 uses one thread per processor.
+// The threads only live for this call; use a ThreadPool to hand out many batches.
+void runTasks(TaskFunction function, void* context, int numTasks, int numThreads) {
+  assert(function != NULL);
+  if (numThreads <= 0)
+    numThreads = defaultNumThreads();
+  if (numThreads > numTasks)
+    numThreads = numTasks;
+  if (numTasks <= 0)
+    return;
+
+  ThreadPool* pool = makeThreadPool(numThreads);
+  poolRun(pool, function, context, numTasks);
+  freeThreadPool(pool);
+}
@@ -0,0 +1,17 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+// A task receives the shared context and its task number (0 <= task < numTasks)
+typedef void (*TaskFunction)(void* context, int task);
+
+// Worker threads that are started once and handed one batch of tasks after another
+typedef struct ThreadPool ThreadPool;
+
+int defaultNumThreads(void);
+void runTasks(TaskFunction function, void* context, int numTasks, int numThreads);
+
+ThreadPool* makeThreadPool(int numThreads);
+void poolRun(ThreadPool* pool, TaskFunction function, void* context, int numTasks);
+void freeThreadPool(ThreadPool* pool);
+
+#endif